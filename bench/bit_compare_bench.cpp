@@ -0,0 +1,82 @@
+/*
+ * bit_compare_bench.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Reports the throughput of each BitCompare path on a masked compare the size
+ * of an Au+ configuration readback.
+ */
+
+#include "bit_compare.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+using get_time = chrono::steady_clock;
+
+int main(int argc, char *argv[]) {
+	size_t length = argc > 1 ? strtoul(argv[1], NULL, 0) : 3800000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 200;
+
+	vector<BYTE> captured(length);
+	vector<BYTE> expected(length);
+	vector<BYTE> mask(length);
+	for (size_t i = 0; i < length; i++) {
+		captured[i] = rand();
+		mask[i] = rand();
+		// bit 0 never differs so the planted differences below are the only ones under the mask
+		expected[i] = captured[i] ^ (~mask[i] & rand() & 0xFE);
+	}
+
+	BitCompare::Path paths[] = { BitCompare::SCALAR, BitCompare::SSE2,
+			BitCompare::AVX2 };
+
+	cout << "Masked compare of " << length << " bytes, " << iterations
+			<< " iterations (best path: "
+			<< BitCompare::pathName(BitCompare::bestPath()) << ")" << endl;
+
+	for (BitCompare::Path path : paths) {
+		if (!BitCompare::supported(path)) {
+			cout << setw(8) << BitCompare::pathName(path) << ": not supported"
+					<< endl;
+			continue;
+		}
+
+		// a difference under the mask has to be found wherever it lands
+		for (size_t at : { (size_t) 0, length / 3, length - 1 }) {
+			mask[at] |= 0x01;
+			expected[at] ^= mask[at];
+			size_t found = BitCompare::firstDifference(captured.data(),
+					expected.data(), mask.data(), length, path);
+			expected[at] ^= mask[at];
+			if (found != at) {
+				cerr << BitCompare::pathName(path)
+						<< " missed the difference at byte " << at << "!"
+						<< endl;
+				return 1;
+			}
+		}
+
+		size_t found = length;
+		auto start = get_time::now();
+		for (int i = 0; i < iterations; i++) // a passing compare reads every byte
+			found = min(found, BitCompare::firstDifference(captured.data(),
+					expected.data(), mask.data(), length, path));
+		auto end = get_time::now();
+		if (found != length) {
+			cerr << BitCompare::pathName(path)
+					<< " found a difference outside the mask!" << endl;
+			return 1;
+		}
+
+		double seconds = chrono::duration<double>(end - start).count();
+		double gbps = (double) length * iterations / seconds / 1e9;
+		cout << setw(8) << BitCompare::pathName(path) << ": " << fixed
+				<< setprecision(2) << gbps << " GB/s" << endl;
+	}
+
+	return 0;
+}
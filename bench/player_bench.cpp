@@ -0,0 +1,116 @@
+/*
+ * player_bench.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Plays the same vectors as SVF and as XSVF on a connected board and reports
+ * the size of each file and how long it took to play. Every device on the chain
+ * is put in BYPASS and random data is checked on its way back out, so any
+ * board works. Run as player_bench [board] [scans] [bits per scan].
+ */
+
+#include "jtag.h"
+#include "jtag_chain.h"
+#include "svf_player.h"
+#include "xsvf_player.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+
+using namespace std;
+using get_time = chrono::steady_clock;
+
+// XSVF values are stored most significant byte first
+static void putValue(ostream &out, const BitBuffer &value) {
+	for (unsigned int i = value.byteCount(); i > 0; i--)
+		out.put(value.data()[i - 1]);
+}
+
+static void putInteger(ostream &out, uint32_t value, unsigned int bytes) {
+	for (unsigned int i = bytes; i > 0; i--)
+		out.put(value >> ((i - 1) * 8));
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int board = argc > 1 ? atoi(argv[1]) : 0;
+	unsigned int scans = argc > 2 ? atoi(argv[2]) : 2000;
+	unsigned int bits = argc > 3 ? atoi(argv[3]) : 256;
+
+	Jtag jtag;
+	if (jtag.connect(board) != FT_OK || !jtag.initialize()) {
+		cerr << "Failed to connect to board " << board << "!" << endl;
+		return 2;
+	}
+	jtag.setFreq(10000000);
+
+	JtagChain chain(&jtag);
+	if (!chain.scan())
+		return 2;
+	unsigned int irLength = 0;
+	for (unsigned int i = 0; i < chain.size(); i++)
+		irLength += chain.getDevice(i).irLength;
+	unsigned int delay = chain.size(); // one BYPASS bit per device
+	jtag.setPadding(0, 0, 0, 0);
+
+	BitBuffer bypass = BitBuffer::ones(irLength);
+	BitBuffer mask = BitBuffer::ones(bits);
+	for (unsigned int i = 0; i < delay; i++)
+		mask.setBit(i, false); // the bits captured by the BYPASS registers
+
+	stringstream svf;
+	stringstream xsvf;
+	svf << "STATE RESET;\nENDIR IDLE;\nENDDR IDLE;\nSIR " << irLength
+			<< " TDI (" << bypass.toHex() << ");\n";
+	xsvf.put(0x07); // XREPEAT 0 so the checks are batched
+	xsvf.put(0);
+	xsvf.put(0x12); // XSTATE RESET
+	xsvf.put(0);
+	xsvf.put(0x15); // XSIR2
+	putInteger(xsvf, irLength, 2);
+	putValue(xsvf, bypass);
+	xsvf.put(0x08); // XSDRSIZE
+	putInteger(xsvf, bits, 4);
+	xsvf.put(0x01); // XTDOMASK
+	putValue(xsvf, mask);
+
+	for (unsigned int n = 0; n < scans; n++) {
+		BitBuffer tdi(bits);
+		BitBuffer tdo(bits);
+		for (unsigned int i = 0; i < tdi.byteCount(); i++)
+			tdi.data()[i] = rand();
+		tdi.resize(bits);
+		for (unsigned int i = delay; i < bits; i++)
+			tdo.setBit(i, tdi.getBit(i - delay));
+
+		svf << "SDR " << bits << " TDI (" << tdi.toHex() << ") TDO ("
+				<< tdo.toHex() << ") MASK (" << mask.toHex() << ");\n";
+		xsvf.put(0x09); // XSDRTDO
+		putValue(xsvf, tdi);
+		putValue(xsvf, tdo);
+	}
+	xsvf.put(0x00); // XCOMPLETE
+
+	cout << scans << " scans of " << bits << " bits through " << chain.size()
+			<< " devices at " << jtag.getFreq() / 1000000.0 << " MHz" << endl;
+
+	SvfPlayer svfPlayer(&jtag);
+	auto start = get_time::now();
+	bool svfOk = svfPlayer.play(svf);
+	double svfSeconds = chrono::duration<double>(get_time::now() - start).count();
+
+	XsvfPlayer xsvfPlayer(&jtag);
+	start = get_time::now();
+	bool xsvfOk = xsvfPlayer.play(xsvf);
+	double xsvfSeconds = chrono::duration<double>(get_time::now() - start).count();
+
+	cout << fixed << setprecision(3);
+	cout << "   SVF: " << setw(9) << svf.str().size() << " bytes, " << svfSeconds
+			<< " s" << (svfOk ? "" : " (failed)") << endl;
+	cout << "  XSVF: " << setw(9) << xsvf.str().size() << " bytes, "
+			<< xsvfSeconds << " s" << (xsvfOk ? "" : " (failed)") << endl;
+
+	jtag.disconnect();
+	return svfOk && xsvfOk ? 0 : 1;
+}
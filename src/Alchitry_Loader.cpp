@@ -25,6 +25,12 @@
 
 #include <cstring>
 #include "config_type.h"
+#include "freq_cache.h"
+#include "jtag_chain.h"
+#include "svf_player.h"
+#include "xsvf_player.h"
+#include "bsdl.h"
+#include "boundary_scan.h"
 
 #define BOARD_ERROR -2
 #define BOARD_UNKNOWN -1
@@ -414,10 +420,19 @@ void printUsage() {
     cout << "  -h : print this help message" << endl;
     cout << "  -f config.bin : write FPGA flash" << endl;
     cout << "  -r config.bin : write FPGA RAM" << endl;
+    cout << "  -v : read the FPGA back after writing RAM and verify it (Au only)" << endl;
+    cout << "  -m config.msk : readback mask for -v, bits that are set aren't compared" << endl;
+    cout << "  -d : print the FPGA's decoded configuration status registers (Au only)" << endl;
     cout << "  -u config.data : write FTDI eeprom" << endl;
     cout << "  -b n : select board \"n\" (defaults to 0)" << endl;
     cout << "  -p loader.bin : Au bridge bin" << endl;
     cout << "  -t TYPE : TYPE can be au, au+, or cu (defaults to au)" << endl;
+    cout << "  -c : calibrate the JTAG clock for this board and cache it" << endl;
+    cout << "  -j n : target device \"n\" of the JTAG chain (defaults to the first FPGA)" << endl;
+    cout << "  -s file.svf : play an SVF file on the JTAG chain" << endl;
+    cout << "  -x file.xsvf : play an XSVF file on the JTAG chain" << endl;
+    cout << "  -i file.bsd : run a boundary-scan interconnect test on the JTAG target" << endl;
+    cout << "  -o A1,B2,... : limit the boundary-scan test to these pins (defaults to all I/O)" << endl;
 }
 
 int main(int argc, char *argv[]) {
@@ -432,9 +447,21 @@ int main(int argc, char *argv[]) {
     string eepromConfig;
     string fpgaBinFlash;
     string fpgaBinRam;
+    bool verify = false;
+    bool status = false;
+    string maskFile;
     bool erase = false;
     bool list = false;
     bool print = false;
+    bool calibrate = false;
+    bool svf = false;
+    string svfFile;
+    bool xsvf = false;
+    string xsvfFile;
+    bool bscan = false;
+    string bsdlFile;
+    vector<string> bscanPins;
+    int chainDevice = -1;
     int deviceNumber = -1;
     bool bridgeProvided = false;
     string auBridgeBin;
@@ -451,6 +478,9 @@ int main(int argc, char *argv[]) {
         } else if (arg == "-h") {
             i++;
             print = true;
+        } else if (arg == "-c") {
+            i++;
+            calibrate = true;
         } else if (arg == "-f") {
             if (argc <= i + 1) {
                 cerr << "Missing bin file!" << endl;
@@ -469,6 +499,59 @@ int main(int argc, char *argv[]) {
             fpgaRam = true;
             fpgaBinRam = argv[i + 1];
             i += 2;
+        } else if (arg == "-v") {
+            i++;
+            verify = true;
+        } else if (arg == "-d") {
+            i++;
+            status = true;
+        } else if (arg == "-m") {
+            if (argc <= i + 1) {
+                cerr << "Missing mask file!" << endl;
+                printUsage();
+                return 1;
+            }
+            maskFile = argv[i + 1];
+            i += 2;
+        } else if (arg == "-s") {
+            if (argc <= i + 1) {
+                cerr << "Missing SVF file!" << endl;
+                printUsage();
+                return 1;
+            }
+            svf = true;
+            svfFile = argv[i + 1];
+            i += 2;
+        } else if (arg == "-x") {
+            if (argc <= i + 1) {
+                cerr << "Missing XSVF file!" << endl;
+                printUsage();
+                return 1;
+            }
+            xsvf = true;
+            xsvfFile = argv[i + 1];
+            i += 2;
+        } else if (arg == "-i") {
+            if (argc <= i + 1) {
+                cerr << "Missing BSDL file!" << endl;
+                printUsage();
+                return 1;
+            }
+            bscan = true;
+            bsdlFile = argv[i + 1];
+            i += 2;
+        } else if (arg == "-o") {
+            if (argc <= i + 1) {
+                cerr << "Missing pin list!" << endl;
+                printUsage();
+                return 1;
+            }
+            stringstream pins(argv[i + 1]);
+            string pin;
+            while (getline(pins, pin, ','))
+                if (!pin.empty())
+                    bscanPins.push_back(pin);
+            i += 2;
         } else if (arg == "-u") {
             if (argc <= i + 1) {
                 cerr << "Missing data file!" << endl;
@@ -497,6 +580,25 @@ int main(int argc, char *argv[]) {
                 return 1;
             }
             i += 2;
+        } else if (arg == "-j") {
+            if (argc <= i + 1) {
+                cerr << "Missing JTAG device number!" << endl;
+                printUsage();
+                return 1;
+            }
+            try {
+                chainDevice = stoi(argv[i + 1]);
+            } catch (const std::invalid_argument &ia) {
+                cerr << argv[i + 1] << " is not a number!" << endl;
+                printUsage();
+                return 1;
+            }
+            if (chainDevice < 0) {
+                cerr << "Device numbers can't be negative!" << endl;
+                printUsage();
+                return 1;
+            }
+            i += 2;
         } else if (arg == "-p") {
             if (argc <= i + 1) {
                 cerr << "Missing bin file!" << endl;
@@ -552,7 +654,8 @@ int main(int argc, char *argv[]) {
     if (eeprom)
         programDevice(deviceNumber, eepromConfig);
 
-    if (erase || fpgaFlash || fpgaRam) {
+    if (erase || fpgaFlash || fpgaRam || calibrate || svf || xsvf || bscan
+            || status) {
         int boardType = getDeviceType(deviceNumber);
         if (board != boardType) {
             cerr << "Invalid board type detected!" << endl;
@@ -575,6 +678,101 @@ int main(int argc, char *argv[]) {
             }
             Loader loader(&jtag);
 
+            // every Loader scan is padded to reach just the chosen device. A lone
+            // FPGA needs no padding so the scan only has to work for -j or a chain.
+            JtagChain chain(&jtag);
+            bool scanned = chain.scan();
+            if (!scanned) {
+                if (chainDevice >= 0) {
+                    cerr << "Failed to scan the JTAG chain!" << endl;
+                    return 2;
+                }
+                cerr << "Failed to scan the JTAG chain, assuming the FPGA is the only device."
+                     << endl;
+                jtag.setPadding(0, 0, 0, 0);
+            } else {
+                if (chainDevice < 0)
+                    chainDevice = chain.size() == 1 ? 0 : chain.findFpga();
+                if (chain.size() > 1) {
+                    cout << "JTAG chain:" << endl;
+                    for (unsigned int i = 0; i < chain.size(); i++)
+                        cout << "  " << i << ": IDCODE " << hex << setw(8) << setfill('0')
+                             << chain.getDevice(i).idcode << dec << setfill(' ') << ", IR "
+                             << chain.getDevice(i).irLength << " bits"
+                             << (i == (unsigned int) chainDevice ? " (target)" : "") << endl;
+                }
+                if (chainDevice < 0 || !chain.select(chainDevice)) {
+                    cerr << "Invalid JTAG device!" << endl;
+                    return 2;
+                }
+            }
+
+            // boards keep the TCK they were calibrated at, keyed by FTDI serial number
+            FreqCache freqCache;
+            string serial = jtag.getSerialNumber();
+            double freq;
+            freqCache.load(FreqCache::defaultPath());
+            if (calibrate) {
+                cout << "Calibrating JTAG clock... ";
+                freq = loader.calibrateFreq();
+                if (freq > 0) {
+                    cout << freq / 1000000.0 << " MHz." << endl;
+                    freqCache.set(serial, freq);
+                    freqCache.save();
+                } else {
+                    cerr << "Failed! Keeping the default clock." << endl;
+                }
+            } else if (freqCache.get(serial, &freq)) {
+                loader.setFreq(freq);
+            }
+
+            if (svf || xsvf) {
+                // SVF and XSVF files cover the whole chain with their own header and trailer bits
+                jtag.setPadding(0, 0, 0, 0);
+                jtag.setFreq(loader.getFreq());
+                if (svf) {
+                    SvfPlayer player(&jtag);
+                    cout << "Playing " << svfFile << "... " << endl;
+                    if (!player.play(svfFile)) {
+                        cerr << "Failed to play SVF file!" << endl;
+                    } else {
+                        cout << "Done." << endl;
+                    }
+                }
+                if (xsvf) {
+                    XsvfPlayer player(&jtag);
+                    cout << "Playing " << xsvfFile << "... " << endl;
+                    if (!player.play(xsvfFile)) {
+                        cerr << "Failed to play XSVF file!" << endl;
+                    } else {
+                        cout << "Done." << endl;
+                    }
+                }
+                if (scanned)
+                    chain.select(chainDevice);
+            }
+
+            if (bscan && !scanned) {
+                cerr << "The boundary-scan test needs the JTAG chain scan, skipping it."
+                     << endl;
+            } else if (bscan) {
+                Bsdl bsdl;
+                BoundaryScan test(&jtag, &bsdl);
+                const JtagChain::Device &target = chain.getDevice(chainDevice);
+                cout << "Running boundary-scan test... " << endl;
+                if (!bsdl.load(bsdlFile)) {
+                    cerr << "Failed to load BSDL file!" << endl;
+                } else if (bsdl.getIrLength() != target.irLength
+                        || !bsdl.matchesIdcode(target.idcode)) {
+                    cerr << "BSDL file for " << bsdl.getEntity()
+                         << " doesn't match the JTAG target!" << endl;
+                } else if (!test.setPins(bscanPins) || !test.interconnectTest()) {
+                    cerr << "Boundary-scan test failed!" << endl;
+                } else {
+                    cout << "Done." << endl;
+                }
+            }
+
             if (erase) {
                 if (!loader.eraseFlash(auBridgeBin)) {
                     cerr << "Failed to erase flash!" << endl;
@@ -592,11 +790,30 @@ int main(int argc, char *argv[]) {
             if (fpgaRam) {
                 if (!loader.writeBin(fpgaBinRam, false, "")) {
                     cerr << "Failed to write FPGA RAM!" << endl;
+                } else if (verify && !loader.verifyBin(fpgaBinRam, maskFile)) {
+                    cerr << "Failed to verify FPGA RAM!" << endl;
                 }
             }
 
+            if (status) {
+                if (!loader.printRegisters())
+                    cerr << "Failed to read the configuration registers!" << endl;
+            }
+
             jtag.disconnect();
         } else if (boardType == BOARD_CU) {
+            if (calibrate)
+                cerr << "Alchitry Cu doesn't use JTAG, skipping calibration."
+                     << endl;
+            if (svf || xsvf)
+                cerr << "Alchitry Cu doesn't use JTAG, skipping SVF and XSVF files."
+                     << endl;
+            if (bscan)
+                cerr << "Alchitry Cu doesn't use JTAG, skipping the boundary-scan test."
+                     << endl;
+            if (verify || status)
+                cerr << "Alchitry Cu can't read back its configuration, skipping verify and status."
+                     << endl;
             Spi spi;
             if (spi.connect(deviceNumber) != FT_OK) {
                 cerr << "Failed to connect to SPI!" << endl;
@@ -0,0 +1,141 @@
+/*
+ * bit_buffer.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bit_buffer.h"
+#include "bit_compare.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+BitBuffer::BitBuffer() {
+	bits = 0;
+}
+
+BitBuffer::BitBuffer(unsigned int bitCount) :
+		bytes((bitCount + 7) / 8, 0) {
+	bits = bitCount;
+}
+
+BitBuffer::BitBuffer(const BYTE *data, unsigned int bitCount) :
+		bytes(data, data + (bitCount + 7) / 8) {
+	bits = bitCount;
+}
+
+static int hexValue(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+// The last character of the string is the least significant nibble and ends up in byte 0
+BitBuffer BitBuffer::fromHex(string hex) {
+	return fromHex(hex, hex.length() * 4);
+}
+
+BitBuffer BitBuffer::fromHex(string hex, unsigned int bitCount) {
+	BitBuffer buffer(bitCount);
+	unsigned int length = hex.length();
+	for (unsigned int i = 0; i < length && i / 2 < buffer.byteCount(); i++) {
+		int value = hexValue(hex[length - 1 - i]);
+		if (value < 0) {
+			cerr << "Invalid hex character " << hex[length - 1 - i]
+					<< " in string " << hex << endl;
+			return BitBuffer();
+		}
+		buffer.bytes[i / 2] |= value << ((i & 1) * 4);
+	}
+	buffer.resize(bitCount); // clear anything past the end
+	return buffer;
+}
+
+// A buffer of bitCount set bits
+BitBuffer BitBuffer::ones(unsigned int bitCount) {
+	BitBuffer buffer(bitCount);
+	fill(buffer.bytes.begin(), buffer.bytes.end(), 0xFF);
+	buffer.resize(bitCount);
+	return buffer;
+}
+
+string BitBuffer::toHex() const {
+	static const char digits[] = "0123456789abcdef";
+	unsigned int length = (bits + 3) / 4;
+	string hex(length, '0');
+	for (unsigned int i = 0; i < length; i++)
+		hex[length - 1 - i] = digits[(bytes[i / 2] >> ((i & 1) * 4)) & 0x0F];
+	return hex;
+}
+
+void BitBuffer::resize(unsigned int bitCount) {
+	bits = bitCount;
+	bytes.resize((bitCount + 7) / 8, 0);
+	if (bitCount % 8 != 0)
+		bytes.back() &= (1 << (bitCount % 8)) - 1;
+}
+
+// Adds the bits of other after the last bit, in LSB_FIRST order
+void BitBuffer::append(const BitBuffer &other) {
+	unsigned int start = bits / 8;
+	unsigned int shift = bits % 8;
+
+	resize(bits + other.bits);
+	for (unsigned int i = 0; i < other.bytes.size(); i++) {
+		bytes[start + i] |= other.bytes[i] << shift;
+		if (shift > 0 && start + i + 1 < bytes.size())
+			bytes[start + i + 1] |= other.bytes[i] >> (8 - shift);
+	}
+}
+
+bool BitBuffer::getBit(unsigned int bit, BitOrder order) const {
+	unsigned int shift = order == LSB_FIRST ? bit % 8 : 7 - bit % 8;
+	return (bytes[bit / 8] >> shift) & 0x01;
+}
+
+void BitBuffer::setBit(unsigned int bit, bool value, BitOrder order) {
+	unsigned int shift = order == LSB_FIRST ? bit % 8 : 7 - bit % 8;
+	if (value)
+		bytes[bit / 8] |= 1 << shift;
+	else
+		bytes[bit / 8] &= ~(1 << shift);
+}
+
+void BitBuffer::reverseBytes() {
+	std::reverse(bytes.begin(), bytes.end());
+}
+
+BYTE BitBuffer::reverse(BYTE b) {
+	b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+	b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+	b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+	return b;
+}
+
+// Compares the first bitCount bits of a and b where mask is set. A null mask compares every bit.
+bool BitBuffer::compare(const BYTE *a, const BYTE *b, const BYTE *mask,
+		unsigned int bitCount, BitOrder order) {
+	return mismatch(a, b, mask, bitCount, order) == bitCount;
+}
+
+// Index of the first of bitCount bits that differs between a and b where mask is set, bitCount if none do
+unsigned int BitBuffer::mismatch(const BYTE *a, const BYTE *b,
+		const BYTE *mask, unsigned int bitCount, BitOrder order) {
+	unsigned int length = (bitCount + 7) / 8;
+	unsigned int i = BitCompare::firstDifference(a, b, mask, length);
+	if (i == length)
+		return bitCount;
+
+	BYTE diff = (a[i] ^ b[i]) & (mask ? mask[i] : 0xFF);
+	if (order == MSB_FIRST)
+		diff = reverse(diff);
+	for (unsigned int bit = i * 8; bit < bitCount; bit++, diff >>= 1)
+		if (diff & 0x01)
+			return bit;
+	return bitCount; // only bits past the end differ
+}
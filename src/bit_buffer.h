@@ -0,0 +1,71 @@
+/*
+ * bit_buffer.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef BIT_BUFFER_H_
+#define BIT_BUFFER_H_
+
+#include "ftd2xx.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Packed bit vector used for everything that gets shifted through the JTAG
+ * chain. Bit i is stored in byte i / 8. With LSB_FIRST order (the JTAG default)
+ * it is bit i % 8 of that byte, with MSB_FIRST order (Xilinx bitstreams) it is
+ * bit 7 - i % 8. The bytes are kept in the order they are shifted so a .bin
+ * file can be used as is.
+ */
+class BitBuffer {
+	vector<BYTE> bytes;
+	unsigned int bits;
+
+public:
+	enum BitOrder {
+		LSB_FIRST, MSB_FIRST
+	};
+
+	BitBuffer();
+	BitBuffer(unsigned int);
+	BitBuffer(const BYTE*, unsigned int);
+
+	static BitBuffer fromHex(string);
+	static BitBuffer fromHex(string, unsigned int);
+	static BitBuffer ones(unsigned int);
+	string toHex() const;
+
+	unsigned int size() const {
+		return bits;
+	}
+	unsigned int byteCount() const {
+		return bytes.size();
+	}
+	bool empty() const {
+		return bits == 0;
+	}
+	BYTE* data() {
+		return bytes.data();
+	}
+	const BYTE* data() const {
+		return bytes.data();
+	}
+
+	void resize(unsigned int);
+	void append(const BitBuffer&);
+	bool getBit(unsigned int, BitOrder = LSB_FIRST) const;
+	void setBit(unsigned int, bool, BitOrder = LSB_FIRST);
+
+	void reverseBytes();
+
+	static BYTE reverse(BYTE);
+	static bool compare(const BYTE*, const BYTE*, const BYTE*, unsigned int,
+			BitOrder = LSB_FIRST);
+	static unsigned int mismatch(const BYTE*, const BYTE*, const BYTE*,
+			unsigned int, BitOrder = LSB_FIRST);
+};
+
+#endif /* BIT_BUFFER_H_ */
@@ -0,0 +1,139 @@
+/*
+ * bit_compare.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bit_compare.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BIT_COMPARE_X86
+#include <immintrin.h>
+#endif
+
+// Index of the first of the length bytes where a and b differ under mask, length if they match
+size_t BitCompare::firstDifference(const BYTE *a, const BYTE *b,
+		const BYTE *mask, size_t length) {
+	static const Path path = bestPath();
+	return firstDifference(a, b, mask, length, path);
+}
+
+size_t BitCompare::firstDifference(const BYTE *a, const BYTE *b,
+		const BYTE *mask, size_t length, Path path) {
+	switch (path) {
+	case AVX2:
+		return differenceAvx2(a, b, mask, length);
+	case SSE2:
+		return differenceSse2(a, b, mask, length);
+	default:
+		return differenceScalar(a, b, mask, length);
+	}
+}
+
+bool BitCompare::supported(Path path) {
+	switch (path) {
+	case SCALAR:
+		return true;
+#ifdef BIT_COMPARE_X86
+	case SSE2:
+		return __builtin_cpu_supports("sse2");
+	case AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+BitCompare::Path BitCompare::bestPath() {
+	if (supported(AVX2))
+		return AVX2;
+	if (supported(SSE2))
+		return SSE2;
+	return SCALAR;
+}
+
+const char* BitCompare::pathName(Path path) {
+	switch (path) {
+	case AVX2:
+		return "AVX2";
+	case SSE2:
+		return "SSE2";
+	default:
+		return "scalar";
+	}
+}
+
+size_t BitCompare::differenceScalar(const BYTE *a, const BYTE *b,
+		const BYTE *mask, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		BYTE m = mask ? mask[i] : 0xFF;
+		if ((a[i] ^ b[i]) & m)
+			return i;
+	}
+	return length;
+}
+
+#ifdef BIT_COMPARE_X86
+
+// Blocks are only tested for a difference, the scalar loop finds it within the block
+__attribute__((target("sse2")))
+size_t BitCompare::differenceSse2(const BYTE *a, const BYTE *b,
+		const BYTE *mask, size_t length) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi8(-1);
+
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16) {
+		__m128i diff = _mm_xor_si128(
+				_mm_loadu_si128((const __m128i *) (a + i)),
+				_mm_loadu_si128((const __m128i *) (b + i)));
+		diff = _mm_and_si128(diff,
+				mask ? _mm_loadu_si128((const __m128i *) (mask + i)) : ones);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero)) != 0xFFFF)
+			break;
+	}
+	return i + differenceScalar(a + i, b + i, mask ? mask + i : NULL,
+			length - i);
+}
+
+__attribute__((target("avx2")))
+size_t BitCompare::differenceAvx2(const BYTE *a, const BYTE *b,
+		const BYTE *mask, size_t length) {
+	const __m256i ones = _mm256_set1_epi8(-1);
+
+	// two vectors per pass so the loads aren't waiting on the test
+	size_t i = 0;
+	for (; i + 64 <= length; i += 64) {
+		__m256i diff0 = _mm256_xor_si256(
+				_mm256_loadu_si256((const __m256i *) (a + i)),
+				_mm256_loadu_si256((const __m256i *) (b + i)));
+		__m256i diff1 = _mm256_xor_si256(
+				_mm256_loadu_si256((const __m256i *) (a + i + 32)),
+				_mm256_loadu_si256((const __m256i *) (b + i + 32)));
+		diff0 = _mm256_and_si256(diff0,
+				mask ? _mm256_loadu_si256((const __m256i *) (mask + i)) : ones);
+		diff1 = _mm256_and_si256(diff1,
+				mask ? _mm256_loadu_si256((const __m256i *) (mask + i + 32)) :
+						ones);
+		__m256i diff = _mm256_or_si256(diff0, diff1);
+		if (!_mm256_testz_si256(diff, diff))
+			break;
+	}
+	return i + differenceSse2(a + i, b + i, mask ? mask + i : NULL,
+			length - i);
+}
+
+#else
+
+size_t BitCompare::differenceSse2(const BYTE *a, const BYTE *b,
+		const BYTE *mask, size_t length) {
+	return differenceScalar(a, b, mask, length);
+}
+
+size_t BitCompare::differenceAvx2(const BYTE *a, const BYTE *b,
+		const BYTE *mask, size_t length) {
+	return differenceScalar(a, b, mask, length);
+}
+
+#endif
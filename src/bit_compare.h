@@ -0,0 +1,41 @@
+/*
+ * bit_compare.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef BIT_COMPARE_H_
+#define BIT_COMPARE_H_
+
+#include "ftd2xx.h"
+#include <stddef.h>
+
+/*
+ * Masked comparison of two byte buffers, reducing (a ^ b) & mask a vector at
+ * a time. The fastest path the CPU supports is picked the first time it is
+ * used. A null mask compares every bit.
+ */
+class BitCompare {
+public:
+	enum Path {
+		SCALAR, SSE2, AVX2
+	};
+
+	static size_t firstDifference(const BYTE*, const BYTE*, const BYTE*,
+			size_t);
+	static size_t firstDifference(const BYTE*, const BYTE*, const BYTE*,
+			size_t, Path);
+	static bool supported(Path);
+	static Path bestPath();
+	static const char* pathName(Path);
+
+private:
+	static size_t differenceScalar(const BYTE*, const BYTE*, const BYTE*,
+			size_t);
+	static size_t differenceSse2(const BYTE*, const BYTE*, const BYTE*,
+			size_t);
+	static size_t differenceAvx2(const BYTE*, const BYTE*, const BYTE*,
+			size_t);
+};
+
+#endif /* BIT_COMPARE_H_ */
@@ -0,0 +1,91 @@
+/*
+ * bit_file.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bit_file.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// A two byte length of 9, nine bytes of preamble and a two byte length of 1
+static const BYTE preamble[] = { 0x00, 0x09, 0x0F, 0xF0, 0x0F, 0xF0, 0x0F,
+		0xF0, 0x0F, 0xF0, 0x00, 0x00, 0x01 };
+
+// Checks the start of the source for the preamble and rewinds it
+bool BitFile::hasHeader(BitstreamSource &source) {
+	BYTE start[sizeof(preamble)];
+	bool found = readBytes(source, start, sizeof(start))
+			&& equal(start, start + sizeof(start), preamble);
+	return source.rewind() && found;
+}
+
+// Reads the header from the start of the source, which is left at the start of
+// the configuration data. The data has to run to the end of the file.
+bool BitFile::read(BitstreamSource &source) {
+	BYTE start[sizeof(preamble)];
+	if (!source.rewind() || !readBytes(source, start, sizeof(start))
+			|| !equal(start, start + sizeof(start), preamble))
+		return error("Missing .bit file header");
+
+	for (;;) {
+		BYTE key;
+		size_t length;
+		if (!readBytes(source, &key, 1))
+			return error("Missing configuration data");
+
+		if (key == 'e') {
+			if (!readLength(source, 4, &length))
+				return false;
+			if (length != source.remaining())
+				return error("Configuration data is " + to_string(source.remaining())
+						+ " bytes but the header says " + to_string(length));
+			return true;
+		}
+
+		string *field = key == 'a' ? &design : key == 'b' ? &part :
+						key == 'c' ? &date : key == 'd' ? &time : NULL;
+		if (field == NULL)
+			return error("Unknown field " + to_string(key));
+		if (!readLength(source, 2, &length))
+			return false;
+		field->resize(length);
+		if (!readBytes(source, (BYTE*) &(*field)[0], length))
+			return error("Truncated header");
+		size_t end = field->find('\0'); // the strings are null terminated
+		if (end != string::npos)
+			field->resize(end);
+	}
+}
+
+bool BitFile::readBytes(BitstreamSource &source, BYTE *data, size_t length) {
+	while (length > 0) {
+		const BYTE *slice;
+		size_t count = source.next(&slice, length);
+		if (count == 0)
+			return false;
+		copy(slice, slice + count, data);
+		data += count;
+		length -= count;
+	}
+	return true;
+}
+
+// Lengths are stored most significant byte first
+bool BitFile::readLength(BitstreamSource &source, unsigned int bytes,
+		size_t *length) {
+	BYTE data[4];
+	if (!readBytes(source, data, bytes))
+		return error("Truncated header");
+	*length = 0;
+	for (unsigned int i = 0; i < bytes; i++)
+		*length = *length << 8 | data[i];
+	return true;
+}
+
+bool BitFile::error(const string &message) {
+	cerr << "Bit file error: " << message << endl;
+	return false;
+}
@@ -0,0 +1,39 @@
+/*
+ * bit_file.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef BIT_FILE_H_
+#define BIT_FILE_H_
+
+#include "ftd2xx.h"
+#include "bitstream_source.h"
+#include <string>
+
+using namespace std;
+
+/*
+ * The header Vivado puts in front of the configuration data in a .bit file.
+ * It's a fixed preamble and then tagged fields, a to d are strings with a two
+ * byte length and e is the four byte length of the data that follows. Reading
+ * it leaves the source at the start of the data so the data itself is streamed
+ * from the same source without being copied.
+ */
+class BitFile {
+public:
+	string design; // design name, with the UserID and tool version Vivado adds
+	string part; // as in 7a35tftg256
+	string date;
+	string time;
+
+	static bool hasHeader(BitstreamSource&);
+	bool read(BitstreamSource&);
+
+private:
+	static bool readBytes(BitstreamSource&, BYTE*, size_t);
+	static bool readLength(BitstreamSource&, unsigned int, size_t*);
+	static bool error(const string&);
+};
+
+#endif /* BIT_FILE_H_ */
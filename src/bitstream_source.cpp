@@ -0,0 +1,246 @@
+/*
+ * bitstream_source.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bitstream_source.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+BitstreamSource::BitstreamSource() {
+	mapped = NULL;
+	length = 0;
+	position = 0;
+	file = NULL;
+	pool = &ownPool;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fd = -1;
+#endif
+}
+
+// Reads that aren't mapped borrow their slices from sessionPool, which has to
+// outlive the source
+BitstreamSource::BitstreamSource(BufferPool &sessionPool) :
+		BitstreamSource() {
+	pool = &sessionPool;
+}
+
+BitstreamSource::~BitstreamSource() {
+	close();
+}
+
+bool BitstreamSource::open(string filename) {
+	close();
+
+	if (map(filename))
+		return true;
+
+	file = fopen(filename.c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	if (fseek(file, 0L, SEEK_END) == 0) {
+		long fileSize = ftell(file);
+		if (fileSize > 0 && fseek(file, 0L, SEEK_SET) == 0) {
+			length = fileSize;
+			return true;
+		}
+	}
+
+	// not seekable so it is most likely a pipe
+	if (!readPipe()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool BitstreamSource::map(string filename) {
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ,
+			FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (GetFileType(handle) != FILE_TYPE_DISK
+			|| !GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0,
+			NULL);
+	if (mapping == NULL) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(handle);
+		return false;
+	}
+
+	fileHandle = handle;
+	mappingHandle = mapping;
+	mapped = (const BYTE*) view;
+	length = fileSize.QuadPart;
+	position = 0;
+	return true;
+#else
+	return mapDescriptor(::open(filename.c_str(), O_RDONLY));
+#endif
+}
+
+#ifndef _WIN32
+// Maps an open file, taking ownership of the descriptor
+bool BitstreamSource::mapDescriptor(int descriptor) {
+	if (descriptor < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode)
+			|| info.st_size == 0) {
+		::close(descriptor);
+		return false;
+	}
+
+	void *view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, descriptor,
+			0);
+	if (view == MAP_FAILED) {
+		::close(descriptor);
+		return false;
+	}
+	madvise(view, info.st_size, MADV_SEQUENTIAL);
+
+	fd = descriptor;
+	mapped = (const BYTE*) view;
+	length = info.st_size;
+	position = 0;
+	return true;
+}
+#endif
+
+// Spills a stream that can't be seeked to a temporary file, which is then
+// mapped or read like any other file. The loaders need the size up front and
+// seek back after checking the packets, which a pipe can't do.
+bool BitstreamSource::readPipe() {
+	FILE *spill = tmpfile();
+	if (spill == NULL)
+		return false;
+
+	BYTE chunk[4096];
+	size_t total = 0;
+	size_t rc;
+	while ((rc = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		if (fwrite(chunk, 1, rc, spill) != rc) {
+			fclose(spill);
+			return false;
+		}
+		total += rc;
+	}
+	fclose(file);
+	file = NULL;
+
+	if (total == 0 || fflush(spill) != 0) {
+		fclose(spill);
+		return false;
+	}
+
+#ifndef _WIN32
+	// the mapping keeps the deleted file alive once spill is closed
+	if (mapDescriptor(dup(fileno(spill)))) {
+		fclose(spill);
+		return true;
+	}
+#endif
+
+	if (fseek(spill, 0L, SEEK_SET) != 0) {
+		fclose(spill);
+		return false;
+	}
+	file = spill;
+	length = total;
+	position = 0;
+	return true;
+}
+
+void BitstreamSource::close() {
+#ifdef _WIN32
+	if (mapped != NULL)
+		UnmapViewOfFile(mapped);
+	if (mappingHandle != NULL)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	if (mapped != NULL)
+		munmap((void*) mapped, length);
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+#endif
+	if (file != NULL)
+		fclose(file);
+	file = NULL;
+	mapped = NULL;
+	slice = BufferPool::Buffer();
+	length = 0;
+	position = 0;
+}
+
+bool BitstreamSource::rewind() {
+	return seek(0);
+}
+
+// Moves to offset from the start, skipping ahead doesn't read anything in between
+bool BitstreamSource::seek(size_t offset) {
+	if (offset > length)
+		return false;
+	position = offset;
+	if (file != NULL)
+		return fseek(file, offset, SEEK_SET) == 0;
+	return true;
+}
+
+void BitstreamSource::setProgress(const function<void(size_t)> &callback) {
+	progress = callback;
+}
+
+// Points data at the next (up to max) bytes. The slice is valid until the next call.
+size_t BitstreamSource::next(const BYTE **data, size_t max) {
+	size_t count = remaining() < max ? remaining() : max;
+	if (count == 0)
+		return 0;
+
+	if (mapped != NULL) {
+		*data = mapped + position;
+	} else {
+		if (slice.size() < count)
+			slice = pool->get(count);
+		count = fread(slice.data(), 1, count, file);
+		*data = slice.data();
+	}
+
+	position += count;
+	if (progress)
+		progress(position);
+	return count;
+}
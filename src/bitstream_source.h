@@ -0,0 +1,79 @@
+/*
+ * bitstream_source.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef BITSTREAM_SOURCE_H_
+#define BITSTREAM_SOURCE_H_
+
+#include "buffer_pool.h"
+#include "ftd2xx.h"
+#include <stdio.h>
+#include <functional>
+#include <string>
+
+using namespace std;
+
+/*
+ * Read-only, in order access to a bitstream file. Regular files are memory
+ * mapped and handed out as slices of the mapping so nothing is copied to the
+ * heap. If the file can't be mapped it is read with stdio instead, into
+ * slices borrowed from the session's buffer pool.
+ *
+ * Pipes are spilled to a temporary file when opened and that file is mapped
+ * (or read with stdio where it can't be), so a piped bitstream costs disk
+ * rather than RAM. The loaders need the size up front to frame the scan and
+ * seek back after checking the packets, and a pipe can do neither.
+ */
+class BitstreamSource {
+	const BYTE *mapped;
+	size_t length;
+	size_t position;
+	FILE *file;
+	BufferPool ownPool; // lends the stdio slices when no session pool is given
+	BufferPool *pool;
+	BufferPool::Buffer slice; // the last slice read with stdio
+	function<void(size_t)> progress; // told the position after every slice
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#else
+	int fd;
+#endif
+
+public:
+	BitstreamSource();
+	BitstreamSource(BufferPool&);
+	~BitstreamSource();
+	bool open(string);
+	void close();
+	bool rewind();
+	bool seek(size_t);
+	size_t next(const BYTE**, size_t);
+	void setProgress(const function<void(size_t)>&);
+
+	size_t size() const {
+		return length;
+	}
+	size_t remaining() const {
+		return length - position;
+	}
+	size_t tell() const {
+		return position;
+	}
+	bool isMapped() const {
+		return mapped != NULL;
+	}
+
+private:
+	BitstreamSource(const BitstreamSource&);
+	BitstreamSource& operator=(const BitstreamSource&);
+	bool map(string);
+#ifndef _WIN32
+	bool mapDescriptor(int);
+#endif
+	bool readPipe();
+};
+
+#endif /* BITSTREAM_SOURCE_H_ */
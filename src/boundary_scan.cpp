@@ -0,0 +1,283 @@
+/*
+ * boundary_scan.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "boundary_scan.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <set>
+
+using namespace std;
+using get_time = chrono::steady_clock;
+
+// Time the pins get to settle between a vector's update and its capture
+static const double settleTime = 10e-6;
+
+BoundaryScan::BoundaryScan(Jtag *dev, Bsdl *file) {
+	jtag = dev;
+	bsdl = file;
+}
+
+// Picks the pins to test by port name or package pin, all of them if names is
+// empty. Every test pin needs a cell to drive it and one to sample it.
+bool BoundaryScan::setPins(const vector<string> &names) {
+	const vector<Bsdl::Pin> &pins = bsdl->getPins();
+	const vector<Bsdl::Cell> &cells = bsdl->getCells();
+
+	testPins.clear();
+	if (names.empty()) {
+		for (unsigned int i = 0; i < pins.size(); i++)
+			if (pins[i].input >= 0 && pins[i].output >= 0)
+				testPins.push_back(i);
+		if (testPins.empty())
+			return error("No pins can be both driven and sampled");
+	}
+	for (const string &name : names) {
+		int i = bsdl->findPin(name);
+		if (i < 0)
+			return error("Unknown pin " + name);
+		if (pins[i].input < 0 || pins[i].output < 0)
+			return error(name + " can't be both driven and sampled");
+		testPins.push_back(i);
+	}
+
+	safe = BitBuffer(cells.size());
+	for (unsigned int i = 0; i < cells.size(); i++)
+		safe.setBit(i, cells[i].safe);
+	for (const Bsdl::Cell &cell : cells)
+		if (cell.control >= 0)
+			safe.setBit(cell.control, cell.disable);
+	return true;
+}
+
+unsigned int BoundaryScan::pinCount() {
+	return testPins.size();
+}
+
+// The package pin and port of a test pin
+string BoundaryScan::pinName(unsigned int pin) {
+	const Bsdl::Pin &p = bsdl->getPins()[testPins[pin]];
+	return p.ball.empty() ? p.port : p.ball + " (" + p.port + ")";
+}
+
+// PRELOAD puts the safe values in the update latches first so EXTEST doesn't
+// drive whatever was left there when it takes over the pins
+bool BoundaryScan::enter() {
+	if (safe.empty())
+		return error("No pins to test");
+	uint32_t opcode;
+	string preload = bsdl->getOpcode("PRELOAD", &opcode) ? "PRELOAD" : "SAMPLE";
+	return setInstruction(preload)
+			&& jtag->navigateToState(Jtag_fsm::SHIFT_DR)
+			&& jtag->shiftData(safe, NULL)
+			&& jtag->navigateToState(Jtag_fsm::RUN_TEST_IDLE)
+			&& setInstruction("EXTEST");
+}
+
+// Resetting the TAP hands the pins back to the device
+bool BoundaryScan::exit() {
+	return jtag->resetState() && jtag->sendCommands();
+}
+
+// Applies each vector and collects what every test pin read while it was
+// applied. EXTEST captures the pins as the scan before left them so each scan
+// reads back the vector before it and one more, floating everything, reads the
+// last. The scans are queued back to back and read back in batches.
+bool BoundaryScan::run(const vector<Vector> &vectors,
+		vector<BitBuffer> *results) {
+	const vector<Bsdl::Pin> &pins = bsdl->getPins();
+	vector<BitBuffer> captured(vectors.size());
+	unsigned long settle = ceil(settleTime * jtag->getFreq());
+
+	for (unsigned int i = 0; i <= vectors.size(); i++) {
+		BitBuffer tdi = i < vectors.size() ? boundary(vectors[i]) : safe;
+		if (!jtag->navigateToState(Jtag_fsm::SHIFT_DR))
+			return false;
+		bool ok = i == 0 ?
+				jtag->shiftData(tdi, NULL) : jtag->deferRead(tdi, &captured[i - 1]);
+		if (!ok || !jtag->navigateToState(Jtag_fsm::RUN_TEST_IDLE)
+				|| !jtag->sendClocks(settle))
+			return false;
+	}
+	if (!jtag->resolveChecks())
+		return false;
+
+	results->clear();
+	for (const BitBuffer &scan : captured) {
+		BitBuffer sampled(testPins.size());
+		for (unsigned int j = 0; j < testPins.size(); j++)
+			sampled.setBit(j, scan.getBit(pins[testPins[j]].input));
+		results->push_back(move(sampled));
+	}
+	return true;
+}
+
+// Runs the walking ones, walking zeros and counting sequence sets over the
+// test pins and reports every pin that didn't read back what it drove. Without
+// a netlist only the test pins' own connections are checked, shorts between
+// them, to the rails and to anything else driving them.
+bool BoundaryScan::interconnectTest() {
+	unsigned int count = testPins.size();
+	vector<Vector> ones = walkingOnes(count);
+	vector<Vector> zeros = walkingZeros(count);
+	vector<Vector> counting = countingSequence(count);
+	vector<BitBuffer> results;
+	set<unsigned int> failed;
+
+	if (!enter())
+		return false;
+
+	auto start = get_time::now();
+	bool ok = run(ones, &results);
+	if (ok)
+		checkDriven("Walking ones", ones, results, &failed);
+	ok = ok && run(zeros, &results);
+	if (ok)
+		checkDriven("Walking zeros", zeros, results, &failed);
+	ok = ok && run(counting, &results);
+	if (ok)
+		findShorts(counting, results, &failed);
+	double seconds = chrono::duration<double>(get_time::now() - start).count();
+
+	ok = exit() && ok;
+	if (!ok)
+		return false;
+
+	cout << "Ran " << ones.size() + zeros.size() + counting.size()
+			<< " vectors over " << count << " pins in " << seconds << " s"
+			<< endl;
+	if (!failed.empty()) {
+		cerr << failed.size() << " of " << count << " pins failed!" << endl;
+		return false;
+	}
+	return true;
+}
+
+// One vector per pin driving it high and every other pin low
+vector<BoundaryScan::Vector> BoundaryScan::walkingOnes(unsigned int pins) {
+	vector<Vector> vectors(pins, Vector { BitBuffer(pins), BitBuffer::ones(pins) });
+	for (unsigned int i = 0; i < pins; i++)
+		vectors[i].drive.setBit(i, true);
+	return vectors;
+}
+
+// One vector per pin driving it low and every other pin high
+vector<BoundaryScan::Vector> BoundaryScan::walkingZeros(unsigned int pins) {
+	vector<Vector> vectors(pins,
+			Vector { BitBuffer::ones(pins), BitBuffer::ones(pins) });
+	for (unsigned int i = 0; i < pins; i++)
+		vectors[i].drive.setBit(i, false);
+	return vectors;
+}
+
+// The true and complement counting sequence: pin i drives the bits of i + 1,
+// one bit per vector, then their complement. Every pin's sequence is unique and
+// none are constant, so shorts and stuck pins show up in about 2 log2(n) vectors.
+vector<BoundaryScan::Vector> BoundaryScan::countingSequence(unsigned int pins) {
+	unsigned int width = 1;
+	while ((1u << width) < pins + 2)
+		width++;
+
+	vector<Vector> vectors(width * 2,
+			Vector { BitBuffer(pins), BitBuffer::ones(pins) });
+	for (unsigned int bit = 0; bit < width; bit++) {
+		for (unsigned int i = 0; i < pins; i++) {
+			bool value = ((i + 1) >> bit) & 1;
+			vectors[bit].drive.setBit(i, value);
+			vectors[width + bit].drive.setBit(i, !value);
+		}
+	}
+	return vectors;
+}
+
+// The boundary register contents that apply a vector
+BitBuffer BoundaryScan::boundary(const Vector &values) {
+	const vector<Bsdl::Pin> &pins = bsdl->getPins();
+	const vector<Bsdl::Cell> &cells = bsdl->getCells();
+	BitBuffer scan = safe;
+
+	for (unsigned int j = 0; j < testPins.size(); j++) {
+		if (!values.enable.getBit(j))
+			continue;
+		int output = pins[testPins[j]].output;
+		scan.setBit(output, values.drive.getBit(j));
+		if (cells[output].control >= 0)
+			scan.setBit(cells[output].control, !cells[output].disable);
+	}
+	return scan;
+}
+
+bool BoundaryScan::setInstruction(const string &name) {
+	uint32_t opcode;
+	if (!bsdl->getOpcode(name, &opcode))
+		return error("The BSDL file has no " + name + " instruction");
+	return jtag->navigateToState(Jtag_fsm::SHIFT_IR)
+			&& jtag->shiftData(bsdl->getIrLength(), opcode, NULL)
+			&& jtag->navigateToState(Jtag_fsm::RUN_TEST_IDLE);
+}
+
+// Every pin that's driven has to read back what it drove, the first vector it
+// didn't is reported and the pin added to failed
+void BoundaryScan::checkDriven(const string &name,
+		const vector<Vector> &vectors, const vector<BitBuffer> &results,
+		set<unsigned int> *failed) {
+	for (unsigned int j = 0; j < testPins.size(); j++) {
+		for (unsigned int i = 0; i < vectors.size(); i++) {
+			bool drive = vectors[i].drive.getBit(j);
+			if (!vectors[i].enable.getBit(j) || results[i].getBit(j) == drive)
+				continue;
+			cerr << name << ": " << pinName(j) << " drove " << drive
+					<< " but read " << !drive << " on vector " << i << endl;
+			failed->insert(j);
+			break;
+		}
+	}
+}
+
+// Groups the pins that didn't read back their own counting sequence by what
+// they read instead. Pins that read the same thing are shorted together, a
+// constant means stuck to a rail or something else driving the net. Each of
+// them is added to failed.
+void BoundaryScan::findShorts(const vector<Vector> &vectors,
+		const vector<BitBuffer> &results, set<unsigned int> *failed) {
+	map<string, vector<unsigned int>> groups;
+
+	for (unsigned int j = 0; j < testPins.size(); j++) {
+		BitBuffer read(vectors.size());
+		BitBuffer driven(vectors.size());
+		for (unsigned int i = 0; i < vectors.size(); i++) {
+			read.setBit(i, results[i].getBit(j));
+			driven.setBit(i, vectors[i].drive.getBit(j));
+		}
+		if (!BitBuffer::compare(read.data(), driven.data(), NULL, read.size())) {
+			groups[read.toHex()].push_back(j);
+			failed->insert(j);
+		}
+	}
+
+	string low = BitBuffer(vectors.size()).toHex();
+	string high = BitBuffer::ones(vectors.size()).toHex();
+	for (auto &group : groups) {
+		cerr << "Counting sequence: ";
+		for (unsigned int j : group.second)
+			cerr << pinName(j) << (j == group.second.back() ? "" : ", ");
+		if (group.first == low)
+			cerr << (group.second.size() > 1 ? " are" : " is") << " stuck low";
+		else if (group.first == high)
+			cerr << (group.second.size() > 1 ? " are" : " is") << " stuck high";
+		else if (group.second.size() > 1)
+			cerr << " are shorted together";
+		else
+			cerr << " is shorted to another pin";
+		cerr << endl;
+	}
+}
+
+bool BoundaryScan::error(const string &message) {
+	cerr << "Boundary scan error: " << message << endl;
+	return false;
+}
@@ -0,0 +1,62 @@
+/*
+ * boundary_scan.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef BOUNDARY_SCAN_H_
+#define BOUNDARY_SCAN_H_
+
+#include "jtag.h"
+#include "bsdl.h"
+#include "bit_buffer.h"
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Drives and samples the pins of one device through its boundary scan register
+ * with EXTEST, laid out by its BSDL file, to test the connections on a board
+ * without configuring anything. The device is the one the Jtag padding
+ * selects, see JtagChain::select(). Vectors are queued back to back and their
+ * samples read back in batches so thousands of them take a fraction of a second.
+ */
+class BoundaryScan {
+public:
+	// Values for the test pins by index, pins that aren't enabled float
+	class Vector {
+	public:
+		BitBuffer drive;
+		BitBuffer enable;
+	};
+
+	BoundaryScan(Jtag*, Bsdl*);
+	bool setPins(const vector<string>&);
+	unsigned int pinCount();
+	string pinName(unsigned int);
+	bool enter();
+	bool exit();
+	bool run(const vector<Vector>&, vector<BitBuffer>*);
+	bool interconnectTest();
+	static vector<Vector> walkingOnes(unsigned int);
+	static vector<Vector> walkingZeros(unsigned int);
+	static vector<Vector> countingSequence(unsigned int);
+
+private:
+	Jtag *jtag;
+	Bsdl *bsdl;
+	vector<unsigned int> testPins; // indexes into the BSDL pins
+	BitBuffer safe; // every output off and the rest at their safe values
+
+	BitBuffer boundary(const Vector&);
+	bool setInstruction(const string&);
+	void checkDriven(const string&, const vector<Vector>&,
+			const vector<BitBuffer>&, set<unsigned int>*);
+	void findShorts(const vector<Vector>&, const vector<BitBuffer>&,
+			set<unsigned int>*);
+	static bool error(const string&);
+};
+
+#endif /* BOUNDARY_SCAN_H_ */
@@ -0,0 +1,360 @@
+/*
+ * bsdl.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bsdl.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+Bsdl::Bsdl() {
+	irLength = 0;
+}
+
+bool Bsdl::load(string file) {
+	ifstream in(file);
+	if (!in.is_open()) {
+		cerr << "Failed to open file " << file << endl;
+		return false;
+	}
+
+	// comments run to the end of the line and statements can span any number of lines
+	string text;
+	string line;
+	while (getline(in, line)) {
+		size_t comment = line.find("--");
+		if (comment != string::npos)
+			line.erase(comment);
+		text += line;
+		text += ' ';
+	}
+	transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+		return isspace(c) ? ' ' : toupper(c);
+	});
+	return parse(text);
+}
+
+bool Bsdl::parse(const string &text) {
+	stringstream words(text);
+	string word;
+	string name;
+	while (entity.empty() && words >> word)
+		if (word == "ENTITY" && words >> name && words >> word && word == "IS")
+			entity = name;
+	if (entity.empty())
+		return error("No entity");
+
+	// the pin map is a constant, the generic names the one to use if there's more than one
+	string mapName;
+	size_t generic = text.find("PHYSICAL_PIN_MAP");
+	if (generic != string::npos) {
+		size_t quote = text.find('"', generic);
+		size_t end = text.find('"', quote + 1);
+		if (quote != string::npos && end != string::npos
+				&& text.find(';', generic) > quote)
+			mapName = trim(text.substr(quote + 1, end - quote - 1));
+	}
+	for (size_t pos = text.find("PIN_MAP_STRING"); pos != string::npos;
+			pos = text.find("PIN_MAP_STRING", pos + 1)) {
+		size_t assign = text.find(":=", pos);
+		size_t end = text.find(';', pos);
+		if (assign == string::npos || end == string::npos || assign > end)
+			continue;
+		size_t colon = text.rfind(':', pos);
+		size_t constant = text.rfind("CONSTANT", pos);
+		if (constant == string::npos || colon == string::npos || colon < constant)
+			continue;
+		string constantName = trim(text.substr(constant + 8, colon - constant - 8));
+		if (mapName.empty() || constantName == mapName) {
+			if (!parsePinMap(unquote(text.substr(assign + 2, end - assign - 2))))
+				return false;
+			break;
+		}
+	}
+
+	// attribute NAME of ENTITY : entity is VALUE;
+	map<string, string> attributes;
+	for (size_t pos = text.find("ATTRIBUTE "); pos != string::npos;
+			pos = text.find("ATTRIBUTE ", pos + 1)) {
+		if (pos > 0 && !isspace((unsigned char) text[pos - 1]))
+			continue;
+		size_t end = text.find(';', pos);
+		if (end == string::npos)
+			break;
+		stringstream statement(text.substr(pos, end - pos));
+		statement >> word >> name;
+		while (statement >> word && word != "IS")
+			;
+		if (word != "IS")
+			continue; // declares an attribute rather than setting one
+		size_t is = text.find(" IS ", pos);
+		attributes[name] = unquote(text.substr(is + 4, end - is - 4));
+	}
+
+	irLength = atoi(attributes["INSTRUCTION_LENGTH"].c_str());
+	unsigned int boundaryLength = atoi(attributes["BOUNDARY_LENGTH"].c_str());
+	if (irLength == 0 || irLength > 32)
+		return error("Missing or unsupported INSTRUCTION_LENGTH");
+	if (boundaryLength == 0)
+		return error("Missing BOUNDARY_LENGTH");
+
+	for (string code : split(attributes["IDCODE_REGISTER"], ',')) {
+		code.erase(remove(code.begin(), code.end(), ' '), code.end());
+		if (!code.empty())
+			idcodes.push_back(code);
+	}
+
+	cells.assign(boundaryLength, Cell { "*", UNKNOWN, false, -1, false });
+	return parseOpcodes(attributes["INSTRUCTION_OPCODE"])
+			&& parseCells(attributes["BOUNDARY_REGISTER"]);
+}
+
+// "EXTEST (100110), SAMPLE (000001, 000010), ..." where the first opcode of each is used
+bool Bsdl::parseOpcodes(const string &value) {
+	size_t pos = 0;
+	string name;
+	string codes;
+	while (nextGroup(value, &pos, &name, &codes)) {
+		string code = split(codes, ',')[0];
+		if (code.empty() || code.size() != irLength
+				|| code.find_first_not_of("01") != string::npos)
+			return error("Invalid opcode for " + name);
+		opcodes[name] = strtoul(code.c_str(), NULL, 2);
+	}
+	if (pos != value.size())
+		return error("Couldn't parse INSTRUCTION_OPCODE");
+	return true;
+}
+
+// "num (cell, port, function, safe[, ccell, disval, rslt]), ..."
+bool Bsdl::parseCells(const string &value) {
+	size_t pos = 0;
+	string number;
+	string fields;
+	while (nextGroup(value, &pos, &number, &fields)) {
+		vector<string> field = split(fields, ',');
+		unsigned int n = atoi(number.c_str());
+		if (number.find_first_not_of("0123456789") != string::npos
+				|| n >= cells.size() || (field.size() != 4 && field.size() != 7))
+			return error("Invalid boundary register cell " + number);
+
+		Cell &cell = cells[n];
+		cell.port = field[1];
+		cell.function = parseFunction(field[2]);
+		cell.safe = field[3] == "1";
+		if (field.size() == 7) {
+			int control = atoi(field[4].c_str());
+			if (control < 0 || (unsigned int) control >= cells.size())
+				return error("Invalid control cell for cell " + number);
+			cell.control = control;
+			cell.disable = field[5] == "1";
+		}
+
+		if (cell.port == "*")
+			continue;
+		Pin &pin = pinFor(cell.port);
+		if (cell.function == INPUT || cell.function == CLOCK
+				|| cell.function == OBSERVE_ONLY || cell.function == BIDIR)
+			pin.input = n;
+		if (cell.function == OUTPUT2 || cell.function == OUTPUT3
+				|| cell.function == BIDIR)
+			pin.output = n;
+	}
+	if (pos != value.size())
+		return error("Couldn't parse BOUNDARY_REGISTER");
+	return true;
+}
+
+// "PORT:BALL, VECTOR:(BALL, BALL), ..."
+bool Bsdl::parsePinMap(const string &value) {
+	size_t pos = 0;
+	while (pos < value.size()) {
+		size_t colon = value.find(':', pos);
+		if (colon == string::npos)
+			return error("Couldn't parse the pin map");
+		string port = trim(value.substr(pos, colon - pos));
+		size_t start = value.find_first_not_of(' ', colon + 1);
+		if (start == string::npos)
+			return error("Missing package pin for " + port);
+
+		size_t end;
+		if (value[start] == '(') {
+			end = value.find(')', start);
+			if (end == string::npos)
+				return error("Couldn't parse the pin map");
+			pinMap[port] = split(value.substr(start + 1, end - start - 1), ',');
+			end = value.find(',', end);
+		} else {
+			end = value.find(',', start);
+			pinMap[port] = { trim(value.substr(start, end - start)) };
+		}
+		pos = end == string::npos ? value.size() : end + 1;
+	}
+	return true;
+}
+
+// The pin for a port, added the first time a cell names it
+Bsdl::Pin& Bsdl::pinFor(const string &port) {
+	for (Pin &pin : pins)
+		if (pin.port == port)
+			return pin;
+
+	Pin pin { port, "", -1, -1 };
+	size_t index = port.find('(');
+	auto balls = pinMap.find(trim(port.substr(0, index)));
+	if (balls != pinMap.end()) {
+		unsigned int element =
+				index == string::npos ? 0 : atoi(port.c_str() + index + 1);
+		if (element < balls->second.size())
+			pin.ball = balls->second[element];
+	}
+	pins.push_back(pin);
+	return pins.back();
+}
+
+// Joins the quoted strings of a value, values that aren't strings are only trimmed
+string Bsdl::unquote(const string &value) {
+	if (value.find('"') == string::npos)
+		return trim(value);
+
+	string joined;
+	bool quoted = false;
+	for (char c : value) {
+		if (c == '"')
+			quoted = !quoted;
+		else if (quoted)
+			joined += c;
+	}
+	return trim(joined);
+}
+
+// Reads the next "name (contents)" from value, parentheses in the contents
+// have to match. Returns false at the end of the value or on anything else.
+bool Bsdl::nextGroup(const string &value, size_t *pos, string *name,
+		string *contents) {
+	size_t start = value.find_first_not_of(" ,", *pos);
+	if (start == string::npos) {
+		*pos = value.size();
+		return false;
+	}
+	size_t open = value.find('(', start);
+	if (open == string::npos)
+		return false;
+
+	int depth = 0;
+	for (size_t i = open; i < value.size(); i++) {
+		if (value[i] == '(')
+			depth++;
+		else if (value[i] == ')' && --depth == 0) {
+			*name = trim(value.substr(start, open - start));
+			*contents = value.substr(open + 1, i - open - 1);
+			*pos = i + 1;
+			return !name->empty();
+		}
+	}
+	return false;
+}
+
+// Splits on separator outside of parentheses and trims each piece
+vector<string> Bsdl::split(const string &value, char separator) {
+	vector<string> pieces;
+	string piece;
+	int depth = 0;
+	for (char c : value) {
+		if (c == separator && depth == 0) {
+			pieces.push_back(trim(piece));
+			piece.clear();
+			continue;
+		}
+		depth += c == '(' ? 1 : c == ')' ? -1 : 0;
+		piece += c;
+	}
+	pieces.push_back(trim(piece));
+	return pieces;
+}
+
+string Bsdl::trim(const string &value) {
+	size_t start = value.find_first_not_of(" \t\r\n");
+	if (start == string::npos)
+		return "";
+	size_t end = value.find_last_not_of(" \t\r\n");
+	return value.substr(start, end - start + 1);
+}
+
+Bsdl::Function Bsdl::parseFunction(const string &name) {
+	static const map<string, Function> functions = { { "INPUT", INPUT }, {
+			"OUTPUT2", OUTPUT2 }, { "OUTPUT3", OUTPUT3 }, { "CONTROL", CONTROL },
+			{ "CONTROLR", CONTROLR }, { "BIDIR", BIDIR }, { "INTERNAL",
+					INTERNAL }, { "CLOCK", CLOCK }, { "OBSERVE_ONLY",
+					OBSERVE_ONLY } };
+	auto function = functions.find(name);
+	return function == functions.end() ? UNKNOWN : function->second;
+}
+
+bool Bsdl::error(const string &message) {
+	cerr << "BSDL error: " << message << endl;
+	return false;
+}
+
+string Bsdl::getEntity() {
+	return entity;
+}
+
+unsigned int Bsdl::getIrLength() {
+	return irLength;
+}
+
+unsigned int Bsdl::getBoundaryLength() {
+	return cells.size();
+}
+
+bool Bsdl::getOpcode(string name, uint32_t *opcode) {
+	transform(name.begin(), name.end(), name.begin(), ::toupper);
+	auto code = opcodes.find(name);
+	if (code == opcodes.end())
+		return false;
+	*opcode = code->second;
+	return true;
+}
+
+// True if the value matches any IDCODE the file lists, or the file lists none
+bool Bsdl::matchesIdcode(uint32_t value) {
+	if (idcodes.empty())
+		return true;
+	for (const string &code : idcodes) {
+		if (code.size() != 32)
+			continue;
+		bool matches = true;
+		for (unsigned int i = 0; i < 32 && matches; i++) {
+			char c = code[31 - i];
+			matches = c == 'X' || (c == '1') == ((value >> i) & 1);
+		}
+		if (matches)
+			return true;
+	}
+	return false;
+}
+
+const vector<Bsdl::Cell>& Bsdl::getCells() {
+	return cells;
+}
+
+const vector<Bsdl::Pin>& Bsdl::getPins() {
+	return pins;
+}
+
+// Index of the pin with this port name or package pin, -1 if there isn't one
+int Bsdl::findPin(string name) {
+	transform(name.begin(), name.end(), name.begin(), ::toupper);
+	for (size_t i = 0; i < pins.size(); i++)
+		if (pins[i].port == name || pins[i].ball == name)
+			return i;
+	return -1;
+}
@@ -0,0 +1,82 @@
+/*
+ * bsdl.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef BSDL_H_
+#define BSDL_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * The parts of a BSDL file needed to drive a device's boundary scan register:
+ * the instruction length and opcodes, the boundary register cells and the
+ * package pin of each port. Names are case insensitive like the VHDL they come
+ * from and are kept upper case.
+ */
+class Bsdl {
+public:
+	enum Function {
+		INPUT, OUTPUT2, OUTPUT3, CONTROL, CONTROLR, BIDIR, INTERNAL, CLOCK,
+		OBSERVE_ONLY, UNKNOWN
+	};
+
+	// One boundary register cell, cell n is bit n of the data register
+	class Cell {
+	public:
+		string port; // * for cells without a pin
+		Function function;
+		bool safe; // value loaded while the device is made safe, X reads as 0
+		int control; // cell that enables this output, -1 if it's always driven
+		bool disable; // control cell value that turns the output off
+	};
+
+	// A port with the cells that sample and drive it
+	class Pin {
+	public:
+		string port;
+		string ball; // package pin, empty if the file has no pin map
+		int input; // -1 if the pin can't be sampled
+		int output; // -1 if the pin can't be driven
+	};
+
+	Bsdl();
+	bool load(string);
+	string getEntity();
+	unsigned int getIrLength();
+	unsigned int getBoundaryLength();
+	bool getOpcode(string, uint32_t*);
+	bool matchesIdcode(uint32_t);
+	const vector<Cell>& getCells();
+	const vector<Pin>& getPins();
+	int findPin(string);
+
+private:
+	string entity;
+	unsigned int irLength;
+	map<string, uint32_t> opcodes;
+	vector<string> idcodes; // 32 characters of 0, 1 or X, most significant bit first
+	vector<Cell> cells;
+	vector<Pin> pins;
+	map<string, vector<string>> pinMap; // port to package pins, one per element of a vector port
+
+	bool parse(const string&);
+	bool parseOpcodes(const string&);
+	bool parseCells(const string&);
+	bool parsePinMap(const string&);
+	Pin& pinFor(const string&);
+	static string unquote(const string&);
+	static bool nextGroup(const string&, size_t*, string*, string*);
+	static vector<string> split(const string&, char);
+	static string trim(const string&);
+	static Function parseFunction(const string&);
+	static bool error(const string&);
+};
+
+#endif /* BSDL_H_ */
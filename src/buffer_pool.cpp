@@ -0,0 +1,95 @@
+/*
+ * buffer_pool.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "buffer_pool.h"
+#include <utility>
+
+using namespace std;
+
+// The smallest class is 64 bytes so short scans share one list
+static const unsigned int minClassBits = 6;
+
+BufferPool::BufferPool() {
+	allocations = 0;
+}
+
+BufferPool::Buffer BufferPool::get(size_t size) {
+	return Buffer(*this, size);
+}
+
+// Number of buffers the pool has had to allocate since it was created
+unsigned long BufferPool::getAllocations() {
+	return allocations;
+}
+
+// Frees every buffer waiting in the pool
+void BufferPool::clear() {
+	for (unsigned int i = 0; i < classes; i++)
+		freeLists[i].clear();
+}
+
+unsigned int BufferPool::sizeClass(size_t size) {
+	unsigned int bits = minClassBits;
+	while (bits < classes - 1 && ((size_t) 1 << bits) < size)
+		bits++;
+	return bits;
+}
+
+vector<BYTE> BufferPool::acquire(size_t size) {
+	vector<BYTE> bytes;
+	vector<vector<BYTE>> &list = freeLists[sizeClass(size)];
+	if (!list.empty()) {
+		bytes = move(list.back());
+		list.pop_back();
+	} else {
+		bytes.reserve((size_t) 1 << sizeClass(size));
+		allocations++;
+	}
+	bytes.resize(size);
+	return bytes;
+}
+
+void BufferPool::release(vector<BYTE> &bytes) {
+	if (bytes.capacity() < ((size_t) 1 << minClassBits))
+		return;
+	// file it under the largest class it can hold so acquire never has to grow it
+	unsigned int bits = sizeClass(bytes.capacity());
+	if (((size_t) 1 << bits) > bytes.capacity())
+		bits--;
+	bytes.clear();
+	freeLists[bits].push_back(move(bytes));
+}
+
+BufferPool::Buffer::Buffer() {
+	pool = NULL;
+}
+
+BufferPool::Buffer::Buffer(BufferPool &owner, size_t size) :
+		bytes(owner.acquire(size)) {
+	pool = &owner;
+}
+
+BufferPool::Buffer::Buffer(Buffer &&other) :
+		bytes(move(other.bytes)) {
+	pool = other.pool;
+	other.pool = NULL;
+}
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer &&other) {
+	if (this != &other) {
+		if (pool)
+			pool->release(bytes);
+		bytes = move(other.bytes);
+		pool = other.pool;
+		other.pool = NULL;
+	}
+	return *this;
+}
+
+BufferPool::Buffer::~Buffer() {
+	if (pool)
+		pool->release(bytes);
+}
@@ -0,0 +1,64 @@
+/*
+ * buffer_pool.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef BUFFER_POOL_H_
+#define BUFFER_POOL_H_
+
+#include "ftd2xx.h"
+#include <vector>
+
+using namespace std;
+
+/*
+ * Size classed free lists of byte buffers owned by a connection. Buffers are
+ * rounded up to a power of two and go back on their list when released so
+ * repeated scans of similar sizes stop touching the heap once warmed up.
+ * Every buffer the pool has to allocate is counted so tests can check that
+ * steady state operation doesn't allocate.
+ */
+class BufferPool {
+public:
+	// A buffer borrowed from the pool, returned when it goes out of scope
+	class Buffer {
+		BufferPool *pool;
+		vector<BYTE> bytes;
+
+	public:
+		Buffer();
+		Buffer(BufferPool&, size_t);
+		Buffer(Buffer&&);
+		Buffer& operator=(Buffer&&);
+		~Buffer();
+
+		BYTE* data() {
+			return bytes.data();
+		}
+		const BYTE* data() const {
+			return bytes.data();
+		}
+		size_t size() const {
+			return bytes.size();
+		}
+	};
+
+	BufferPool();
+	Buffer get(size_t);
+	unsigned long getAllocations();
+	void clear();
+
+private:
+	static const unsigned int classes = 32;
+	vector<vector<BYTE>> freeLists[classes];
+	unsigned long allocations;
+
+	BufferPool(const BufferPool&);
+	BufferPool& operator=(const BufferPool&);
+	static unsigned int sizeClass(size_t);
+	vector<BYTE> acquire(size_t);
+	void release(vector<BYTE>&);
+};
+
+#endif /* BUFFER_POOL_H_ */
@@ -0,0 +1,193 @@
+/*
+ * config_packets.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "config_packets.h"
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static const uint32_t syncWord = 0xAA995566;
+// The sync word has to turn up within this many bytes of the start
+static const size_t syncSearch = 4096;
+
+const size_t ConfigPackets::frameWords;
+
+ConfigPackets::ConfigPackets() {
+	syncOffset = 0;
+}
+
+// Walks the packets from the sync word to DESYNC or the end of the source,
+// which is left wherever the parse stopped
+bool ConfigPackets::parse(BitstreamSource &source) {
+	size_t start = source.tell();
+	unsigned int reg = 0;
+	bool typeOne = false;
+
+	packets.clear();
+	if (!findSync(source))
+		return error("No sync word");
+	syncOffset = source.tell() - 4;
+
+	while (source.remaining() > 0) {
+		Packet packet;
+		uint32_t header;
+		packet.offset = source.tell();
+		if (!readWord(source, &header))
+			return error("The stream doesn't end on a whole word");
+
+		packet.type = header >> 29;
+		packet.op = (Opcode) ((header >> 27) & 0x03);
+		if (packet.type == 1) {
+			reg = (header >> 13) & 0x3FFF;
+			packet.words = header & 0x7FF;
+			typeOne = true;
+		} else if (packet.type == 2 && typeOne) {
+			packet.words = header & 0x7FFFFFF;
+		} else {
+			stringstream message;
+			message << "Invalid packet header " << hex << setw(8) << setfill('0')
+					<< header << " at byte " << dec << packet.offset - start;
+			return error(message.str());
+		}
+		packet.reg = reg;
+		packet.value = 0;
+
+		if (packet.op == NOOP || packet.op > WRITE)
+			continue;
+		// read data comes out of FDRO, only writes carry their words in the stream
+		if (packet.op == WRITE && packet.words > 0) {
+			if (packet.words * 4 > source.remaining())
+				return error(
+						"Packet at byte " + to_string(packet.offset - start)
+								+ " runs past the end of the stream");
+			if (!readWord(source, &packet.value)
+					|| !source.seek(source.tell() + (packet.words - 1) * 4))
+				return false;
+		}
+		packets.push_back(packet);
+
+		// the device ignores everything after DESYNC, padding included
+		if (packet.op == WRITE && packet.reg == CMD && packet.value == DESYNC)
+			break;
+	}
+	return true;
+}
+
+// Checks the stream can configure the part with this IDCODE: it has to write
+// whole frames, start the device and, if it writes an IDCODE, name this part.
+// An IDCODE of 0 skips the part check. Encrypted streams carry everything after
+// the CBC write inside one FDRI packet so only the IDCODE is checked for them.
+bool ConfigPackets::validate(uint32_t idcode) {
+	bool encrypted = false;
+	for (const Packet &packet : packets) {
+		encrypted = encrypted || (packet.op == WRITE && packet.reg == CBC);
+		if (packet.op != WRITE || packet.reg != IDCODE || idcode == 0)
+			continue;
+		if ((packet.value & 0x0FFFFFFF) != (idcode & 0x0FFFFFFF)) {
+			stringstream message;
+			message << "The bitstream is for IDCODE " << hex << setw(8)
+					<< setfill('0') << packet.value << " but the FPGA is "
+					<< setw(8) << idcode;
+			return error(message.str());
+		}
+	}
+
+	if (encrypted)
+		return true;
+	size_t words = getFrameWords();
+	if (words == 0)
+		return error("No frame data");
+	if (words % frameWords != 0)
+		return error(
+				"The frame data is " + to_string(words)
+						+ " words, not a whole number of frames");
+	if (!hasCommand(START))
+		return error("No START command");
+	return true;
+}
+
+const vector<ConfigPackets::Packet>& ConfigPackets::getPackets() const {
+	return packets;
+}
+
+// Offset of the sync word in the source
+size_t ConfigPackets::getSyncOffset() const {
+	return syncOffset;
+}
+
+// Words written to FDRI, frames and all
+size_t ConfigPackets::getFrameWords() const {
+	size_t words = 0;
+	for (const Packet &packet : packets)
+		if (packet.op == WRITE && packet.reg == FDRI)
+			words += packet.words;
+	return words;
+}
+
+bool ConfigPackets::hasCommand(Command command) const {
+	for (const Packet &packet : packets)
+		if (packet.op == WRITE && packet.reg == CMD && packet.words > 0
+				&& packet.value == command)
+			return true;
+	return false;
+}
+
+// How much of the frame data lies before position, from 0 to 1. The frames are
+// nearly all of a bitstream so this tracks the time a load takes.
+double ConfigPackets::frameProgress(size_t position) const {
+	size_t total = 0;
+	size_t done = 0;
+	for (const Packet &packet : packets) {
+		if (packet.op != WRITE || packet.reg != FDRI)
+			continue;
+		size_t start = packet.offset + 4;
+		size_t end = start + packet.words * 4;
+		total += end - start;
+		if (position > start)
+			done += (position < end ? position : end) - start;
+	}
+	return total == 0 ? 1 : (double) done / total;
+}
+
+// Moves the source past the sync word, which doesn't have to be word aligned
+bool ConfigPackets::findSync(BitstreamSource &source) {
+	uint32_t window = 0;
+	size_t searched = 0;
+	while (searched < syncSearch) {
+		const BYTE *slice;
+		size_t count = source.next(&slice, 1);
+		if (count == 0)
+			return false;
+		window = window << 8 | slice[0];
+		if (window == syncWord)
+			return true;
+		searched++;
+	}
+	return false;
+}
+
+// Words are stored most significant byte first
+bool ConfigPackets::readWord(BitstreamSource &source, uint32_t *word) {
+	unsigned int bytes = 0;
+	*word = 0;
+	while (bytes < 4) {
+		const BYTE *slice;
+		size_t count = source.next(&slice, 4 - bytes);
+		if (count == 0)
+			return false;
+		for (size_t i = 0; i < count; i++)
+			*word = *word << 8 | slice[i];
+		bytes += count;
+	}
+	return true;
+}
+
+bool ConfigPackets::error(const string &message) {
+	cerr << "Bitstream error: " << message << endl;
+	return false;
+}
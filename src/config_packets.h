@@ -0,0 +1,106 @@
+/*
+ * config_packets.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef CONFIG_PACKETS_H_
+#define CONFIG_PACKETS_H_
+
+#include "ftd2xx.h"
+#include "bitstream_source.h"
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+/*
+ * A structured view of a 7-series configuration stream (UG470 chapter 5): the
+ * sync word and every packet after it, located by offset instead of copied.
+ * Only the packet headers and first data words are read, the frame data is
+ * seeked over, so a whole bitstream is checked before any of it is shifted.
+ */
+class ConfigPackets {
+public:
+	enum Opcode {
+		NOOP = 0, READ = 1, WRITE = 2
+	};
+
+	enum Register {
+		CRC = 0x00,
+		FAR = 0x01,
+		FDRI = 0x02,
+		FDRO = 0x03,
+		CMD = 0x04,
+		CTL0 = 0x05,
+		MASK = 0x06,
+		STAT = 0x07,
+		LOUT = 0x08,
+		COR0 = 0x09,
+		MFWR = 0x0A,
+		CBC = 0x0B,
+		IDCODE = 0x0C,
+		AXSS = 0x0D,
+		COR1 = 0x0E,
+		WBSTAR = 0x10,
+		TIMER = 0x11,
+		BOOTSTS = 0x16,
+		CTL1 = 0x18,
+		BSPI = 0x1F
+	};
+
+	enum Command {
+		NULL_CMD = 0x00,
+		WCFG = 0x01,
+		MFW = 0x02,
+		LFRM = 0x03,
+		RCFG = 0x04,
+		START = 0x05,
+		RCAP = 0x06,
+		RCRC = 0x07,
+		AGHIGH = 0x08,
+		SWITCH = 0x09,
+		GRESTORE = 0x0A,
+		SHUTDOWN = 0x0B,
+		GCAPTURE = 0x0C,
+		DESYNC = 0x0D,
+		IPROG = 0x0F,
+		CRCC = 0x10,
+		LTIMER = 0x11,
+		BSPI_READ = 0x12,
+		FALL_EDGE = 0x13
+	};
+
+	// Words in a configuration frame
+	static const size_t frameWords = 101;
+
+	// A read or write, NOOPs aren't kept
+	class Packet {
+	public:
+		size_t offset; // of the header in the stream
+		unsigned int type; // 2 carries on with the register of the type 1 before it
+		Opcode op;
+		unsigned int reg;
+		size_t words;
+		uint32_t value; // first data word of a write, 0 if it has none
+	};
+
+	ConfigPackets();
+	bool parse(BitstreamSource&);
+	bool validate(uint32_t);
+	const vector<Packet>& getPackets() const;
+	size_t getSyncOffset() const;
+	size_t getFrameWords() const;
+	bool hasCommand(Command) const;
+	double frameProgress(size_t) const;
+
+private:
+	size_t syncOffset;
+	vector<Packet> packets;
+
+	static bool findSync(BitstreamSource&);
+	static bool readWord(BitstreamSource&, uint32_t*);
+	static bool error(const string&);
+};
+
+#endif /* CONFIG_PACKETS_H_ */
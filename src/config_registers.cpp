@@ -0,0 +1,158 @@
+/*
+ * config_registers.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "config_registers.h"
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+static const map<unsigned int, vector<ConfigRegisters::Field>> registerFields = {
+		{ ConfigPackets::STAT, {
+				{ "CRC_ERROR", 0, 1 },
+				{ "PART_SECURED", 1, 1 },
+				{ "MMCM_LOCK", 2, 1 },
+				{ "DCI_MATCH", 3, 1 },
+				{ "EOS", 4, 1 },
+				{ "GTS_CFG_B", 5, 1 },
+				{ "GWE", 6, 1 },
+				{ "GHIGH_B", 7, 1 },
+				{ "MODE", 8, 3 },
+				{ "INIT_COMPLETE", 11, 1 },
+				{ "INIT_B", 12, 1 },
+				{ "RELEASE_DONE", 13, 1 },
+				{ "DONE", 14, 1 },
+				{ "ID_ERROR", 15, 1 },
+				{ "DEC_ERROR", 16, 1 },
+				{ "XADC_OVER_TEMP", 17, 1 },
+				{ "STARTUP_STATE", 18, 3 },
+				{ "BUS_WIDTH", 25, 2 } } },
+		{ ConfigPackets::CTL0, {
+				{ "GTS_USR_B", 0, 1 },
+				{ "PERSIST", 3, 1 },
+				{ "SBITS", 4, 2 },
+				{ "DEC", 6, 1 },
+				{ "FARSRC", 7, 1 },
+				{ "GLUTMASK_B", 8, 1 },
+				{ "OVERTEMP_POWERDOWN", 12, 1 },
+				{ "CONFIG_FALLBACK", 13, 1 },
+				{ "ICAP_SELECT", 30, 1 },
+				{ "EFUSE_KEY", 31, 1 } } },
+		{ ConfigPackets::COR0, {
+				{ "GWE_CYCLE", 0, 3 },
+				{ "GTS_CYCLE", 3, 3 },
+				{ "LOCK_CYCLE", 6, 3 },
+				{ "MATCH_CYCLE", 9, 3 },
+				{ "DONE_CYCLE", 12, 3 },
+				{ "SSCLKSRC", 15, 2 },
+				{ "OSCFSEL", 17, 6 },
+				{ "SINGLE", 23, 1 },
+				{ "DRIVE_DONE", 24, 1 },
+				{ "DONE_PIPE", 25, 1 },
+				{ "PWRDWN_STAT", 27, 1 } } },
+		{ ConfigPackets::BOOTSTS, {
+				{ "VALID_0", 0, 1 },
+				{ "FALLBACK_0", 1, 1 },
+				{ "IPROG_0", 2, 1 },
+				{ "WTO_ERROR_0", 3, 1 },
+				{ "ID_ERROR_0", 4, 1 },
+				{ "CRC_ERROR_0", 5, 1 },
+				{ "WRAP_ERROR_0", 6, 1 },
+				{ "HMAC_ERROR_0", 7, 1 },
+				{ "VALID_1", 8, 1 },
+				{ "FALLBACK_1", 9, 1 },
+				{ "IPROG_1", 10, 1 },
+				{ "WTO_ERROR_1", 11, 1 },
+				{ "ID_ERROR_1", 12, 1 },
+				{ "CRC_ERROR_1", 13, 1 },
+				{ "WRAP_ERROR_1", 14, 1 },
+				{ "HMAC_ERROR_1", 15, 1 } } },
+		{ ConfigPackets::IDCODE, {
+				{ "MANUFACTURER", 1, 11 },
+				{ "DEVICE", 12, 16 },
+				{ "REVISION", 28, 4 } } } };
+
+string ConfigRegisters::name(ConfigPackets::Register reg) {
+	switch (reg) {
+	case ConfigPackets::STAT:
+		return "STAT";
+	case ConfigPackets::CTL0:
+		return "CTL0";
+	case ConfigPackets::COR0:
+		return "COR0";
+	case ConfigPackets::BOOTSTS:
+		return "BOOTSTS";
+	case ConfigPackets::IDCODE:
+		return "IDCODE";
+	default:
+		return "register " + to_string(reg);
+	}
+}
+
+// The named fields of a register, empty for registers that aren't decoded
+const vector<ConfigRegisters::Field>& ConfigRegisters::fields(
+		ConfigPackets::Register reg) {
+	static const vector<Field> none;
+	auto found = registerFields.find(reg);
+	return found == registerFields.end() ? none : found->second;
+}
+
+uint32_t ConfigRegisters::field(uint32_t value, const Field &f) {
+	return (value >> f.shift) & ((1u << f.width) - 1);
+}
+
+bool ConfigRegisters::bit(uint32_t stat, Status status) {
+	return (stat >> status) & 1;
+}
+
+// The startup sequencer phase, STARTUP_STATE counts them in Gray code
+unsigned int ConfigRegisters::startupState(uint32_t stat) {
+	static const unsigned int phases[8] = { 0, 1, 3, 2, 7, 6, 4, 5 };
+	return phases[(stat >> 18) & 0x7];
+}
+
+// The raw value and then one field per line
+string ConfigRegisters::describe(ConfigPackets::Register reg, uint32_t value) {
+	stringstream text;
+	text << name(reg) << " " << hex << setw(8) << setfill('0') << value << dec;
+	for (const Field &f : fields(reg)) {
+		text << endl << "  " << left << setw(20) << setfill(' ') << f.name
+				<< right;
+		if (reg == ConfigPackets::STAT && f.name == "STARTUP_STATE")
+			text << "phase " << startupState(value);
+		else
+			text << field(value, f);
+	}
+	return text.str();
+}
+
+// Why a load with this STAT value didn't finish, empty if it did. The errors
+// come first since they stop configuration, then whatever startup is stuck on.
+string ConfigRegisters::diagnose(uint32_t stat) {
+	if (bit(stat, ID_ERROR))
+		return "The bitstream is for a different part (ID_ERROR)";
+	if (bit(stat, CRC_ERROR))
+		return "The bitstream failed its CRC check, it's corrupt or wasn't shifted in cleanly (CRC_ERROR)";
+	if (bit(stat, DEC_ERROR))
+		return "The bitstream couldn't be decrypted with the key in the FPGA (DEC_ERROR)";
+	if (bit(stat, XADC_OVER_TEMP))
+		return "The FPGA is over temperature (XADC_OVER_TEMP)";
+	if (!bit(stat, INIT_COMPLETE))
+		return "The configuration memory never finished clearing (INIT_COMPLETE is low)";
+	if (!bit(stat, INIT_B))
+		return "INIT_B is held low, by the FPGA after an error or by the board";
+	if (bit(stat, DONE))
+		return "";
+	if (startupState(stat) == 0)
+		return "Startup never began, the bitstream was cut short or has no START command";
+	if (!bit(stat, MMCM_LOCK))
+		return "Startup is waiting for an MMCM to lock (LCK_cycle), check its input clock";
+	if (!bit(stat, DCI_MATCH))
+		return "Startup is waiting for DCI to match (Match_cycle), check the VRN/VRP resistors";
+	return "Startup stopped in phase " + to_string(startupState(stat))
+			+ " without DONE going high, check nothing else holds DONE low";
+}
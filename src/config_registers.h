@@ -0,0 +1,59 @@
+/*
+ * config_registers.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef CONFIG_REGISTERS_H_
+#define CONFIG_REGISTERS_H_
+
+#include "config_packets.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * The fields of the 7-series configuration registers the loader reads back
+ * (UG470 tables 5-25 to 5-35) and what a STAT value says about a failed load.
+ * Only the decoding lives here, Loader::readRegisters() does the reading.
+ */
+class ConfigRegisters {
+public:
+	// STAT bits
+	enum Status {
+		CRC_ERROR = 0,
+		PART_SECURED = 1,
+		MMCM_LOCK = 2,
+		DCI_MATCH = 3,
+		EOS = 4,
+		GTS_CFG_B = 5,
+		GWE = 6,
+		GHIGH_B = 7,
+		INIT_COMPLETE = 11,
+		INIT_B = 12,
+		RELEASE_DONE = 13,
+		DONE = 14,
+		ID_ERROR = 15,
+		DEC_ERROR = 16,
+		XADC_OVER_TEMP = 17
+	};
+
+	class Field {
+	public:
+		string name;
+		unsigned int shift;
+		unsigned int width;
+	};
+
+	static string name(ConfigPackets::Register);
+	static const vector<Field>& fields(ConfigPackets::Register);
+	static uint32_t field(uint32_t, const Field&);
+	static bool bit(uint32_t, Status);
+	static unsigned int startupState(uint32_t);
+	static string describe(ConfigPackets::Register, uint32_t);
+	static string diagnose(uint32_t);
+};
+
+#endif /* CONFIG_REGISTERS_H_ */
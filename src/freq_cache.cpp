@@ -0,0 +1,71 @@
+/*
+ * freq_cache.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "freq_cache.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+
+using namespace std;
+
+FreqCache::FreqCache() {
+}
+
+// Reads the cache at file, a missing file is an empty cache
+bool FreqCache::load(string file) {
+	path = file;
+	freqs.clear();
+
+	ifstream input(file);
+	if (!input.is_open())
+		return true;
+
+	string serial;
+	double freq;
+	while (input >> serial >> freq)
+		if (freq > 0)
+			freqs[serial] = freq;
+	return input.eof();
+}
+
+bool FreqCache::save() {
+	if (path.empty())
+		return false;
+
+	ofstream output(path, ios::trunc);
+	if (!output.is_open()) {
+		cerr << "Failed to write TCK cache " << path << endl;
+		return false;
+	}
+	for (auto &entry : freqs)
+		output << entry.first << " " << setprecision(12) << entry.second << endl;
+	return output.good();
+}
+
+bool FreqCache::get(string serial, double *freq) const {
+	auto entry = freqs.find(serial);
+	if (serial.empty() || entry == freqs.end())
+		return false;
+	*freq = entry->second;
+	return true;
+}
+
+void FreqCache::set(string serial, double freq) {
+	if (!serial.empty())
+		freqs[serial] = freq;
+}
+
+// Per user file, next to the other dot files on Linux and in AppData on Windows
+string FreqCache::defaultPath() {
+#ifdef _WIN32
+	const char *dir = getenv("APPDATA");
+	return dir ? string(dir) + "\\alchitry_loader_tck.txt" : "alchitry_loader_tck.txt";
+#else
+	const char *dir = getenv("HOME");
+	return dir ? string(dir) + "/.alchitry_loader_tck" : ".alchitry_loader_tck";
+#endif
+}
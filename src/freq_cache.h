@@ -0,0 +1,34 @@
+/*
+ * freq_cache.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef FREQ_CACHE_H_
+#define FREQ_CACHE_H_
+
+#include <string>
+#include <map>
+
+using namespace std;
+
+/*
+ * Calibrated TCK frequencies keyed by FTDI serial number. The cache is a text
+ * file with one "serial frequency" pair per line so a board that was tuned
+ * once starts at its tuned clock on every later run.
+ */
+class FreqCache {
+	string path;
+	map<string, double> freqs;
+
+public:
+	FreqCache();
+	bool load(string);
+	bool save();
+	bool get(string, double*) const;
+	void set(string, double);
+
+	static string defaultPath();
+};
+
+#endif /* FREQ_CACHE_H_ */
@@ -11,6 +11,9 @@
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 #ifdef _WIN32
 #include "mingw.thread.h"
 #else
@@ -21,9 +24,35 @@
 
 using namespace std;
 
+// TDO is read back in chunks of this size
+static const unsigned int readChunk = 32768;
+static const BYTE zeros[readChunk] = { };
+static const vector<BYTE> ones(readChunk, 0xFF);
+// Payloads at least this long are referenced by the writer instead of copied
+static const unsigned int minReference = 4096;
+
+// MPSSE shift command flag for LSB first data
+static constexpr BYTE lsbFlag(BitBuffer::BitOrder order) {
+	return order == BitBuffer::LSB_FIRST ? 0x08 : 0x00;
+}
+
 Jtag::Jtag() {
 	ftHandle = 0;
 	active = false;
+	transferSize = 65536;
+	readTimeout = 5000;
+	tckFreq = 30000000.0 / (0x05DB + 1);
+	currentState = Jtag_fsm::TEST_LOGIC_RESET;
+	tmsBits = 0;
+	tmsCount = 0;
+	tmsTdi = 0;
+	tmsTdiFixed = false;
+	deferChecks = false;
+	pendingRead = 0;
+	irHeader = 0;
+	irTrailer = 0;
+	drHeader = 0;
+	drTrailer = 0;
 }
 
 FT_STATUS Jtag::connect(unsigned int devNumber) {
@@ -31,6 +60,12 @@ FT_STATUS Jtag::connect(unsigned int devNumber) {
 }
 
 FT_STATUS Jtag::disconnect() {
+	if (active && !checks.empty())
+		resolveChecks();
+	if (active && !sendCommands())
+		cerr << "Failed to send queued commands!" << endl;
+	writer.stop();
+	rxEvent.stop();
 	active = false;
 	return FT_Close(ftHandle);
 }
@@ -60,6 +95,9 @@ bool Jtag::initialize() {
 
 	std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Wait for all the USB stuff to complete and work
 
+	if (!rxEvent.start(ftHandle))
+		cerr << "Failed to set event notification, reads will poll." << endl;
+
 	if (!sync_mpsse()) {
 		cerr << "Failed to sync with MPSSE!" << endl;
 		return false;
@@ -70,9 +108,21 @@ bool Jtag::initialize() {
 		return false;
 	}
 
+	UsbTuner::Profile profile; // falls back to the settings above
+	profile.latency = 16;
+	if (!UsbTuner(ftHandle, rxEvent).select(&profile))
+		cerr << "Failed to tune USB transfers, using the defaults." << endl;
+	transferSize = profile.transferSize;
+
+	// a batch is submitted once it reaches transferSize, one 64KB command past it at most
+	writer.reserve(transferSize + 3 + 65536);
+	writer.start(ftHandle);
 	active = true;
 
-	return true;
+	tmsBits = 0;
+	tmsCount = 0;
+	tmsTdiFixed = false;
+	return resetState(); // the TAP could be in any state after connecting
 }
 
 bool Jtag::sync_mpsse() {
@@ -93,17 +143,14 @@ bool Jtag::sync_mpsse() {
 		cerr << "Failed to send bad command" << endl;
 	// Send off the BAD commands
 	dwNumBytesToSend = 0; // Reset output buffer pointer
-	do {
-		ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
-		if (ftStatus != FT_OK)
-			cerr << "Failed to get queue status " << ftStatus << endl;
-		// Get the number of bytes in the device input buffer
-	} while ((dwNumBytesToRead == 0) && (ftStatus == FT_OK));
-	if (dwNumBytesRead > 8) {
-		cerr << "Input buffer too small in sync_mpsse()!" << endl;
+	// Wait for the two byte echo
+	if (!rxEvent.wait(2, readTimeout))
 		return false;
-	}
-	//or Timeout
+	ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
+	if (ftStatus != FT_OK)
+		return false;
+	if (dwNumBytesToRead > 8)
+		dwNumBytesToRead = 8; // anything past the echo is flushed later
 	bool bCommandEchod = false;
 	ftStatus = FT_Read(ftHandle, &byInputBuffer, dwNumBytesToRead,
 			&dwNumBytesRead);
@@ -228,6 +275,7 @@ bool Jtag::config_jtag() {
 	return true;
 }
 
+// Sets TCK to the fastest MPSSE rate that doesn't exceed freq
 bool Jtag::setFreq(double freq) {
 	if (!active) {
 		cerr
@@ -235,529 +283,684 @@ bool Jtag::setFreq(double freq) {
 				<< endl;
 		return false;
 	}
-	FT_STATUS ftStatus;
-	BYTE byOutputBuffer[8]; // Buffer to hold MPSSE commands and data to be sent to the FT2232H
-	DWORD dwNumBytesToSend = 0; // Index to the output buffer
-	DWORD dwNumBytesSent = 0; // Count of actual bytes sent - used with FT_Write
+	BYTE byOutputBuffer[3]; // Buffer to hold MPSSE commands and data to be sent to the FT2232H
 	DWORD dwClockDivisor; // Value of clock divisor, SCL Frequency = 60/((1+clkDiv)*2) (MHz)
 
-	dwClockDivisor = 30.0 / (freq / 1000000.0) - 1.0;
+	if (freq <= 0)
+		return false;
+
+	// round the divisor up so the exact rates of other divisors aren't truncated down a step
+	double divisor = ceil(30.0 / (freq / 1000000.0) - 1.0 - 1e-9);
+	dwClockDivisor = divisor < 0 ? 0 : divisor > 0xFFFF ? 0xFFFF : divisor;
+	tckFreq = 30000000.0 / (dwClockDivisor + 1);
 
 	// Set TCK frequency
 	// TCK = 60MHz /((1 + [(1 +0xValueH*256) OR 0xValueL])*2)
-	byOutputBuffer[dwNumBytesToSend++] = 0x86;
+	byOutputBuffer[0] = 0x86;
 	//Command to set clock divisor
-	byOutputBuffer[dwNumBytesToSend++] = dwClockDivisor & 0xFF;
+	byOutputBuffer[1] = dwClockDivisor & 0xFF;
 	//Set 0xValueL of clock divisor
-	byOutputBuffer[dwNumBytesToSend++] = (dwClockDivisor >> 8) & 0xFF;
+	byOutputBuffer[2] = (dwClockDivisor >> 8) & 0xFF;
 	//Set 0xValueH of clock divisor
-	ftStatus = FT_Write(ftHandle, byOutputBuffer, dwNumBytesToSend,
-			&dwNumBytesSent);
-	// Send off the clock divisor commands
+	return queueCommand(byOutputBuffer, 3);
+}
 
-	if (ftStatus != FT_OK)
-		return false;
-	return true;
+// The TCK rate actually set, which can be below the one asked for
+double Jtag::getFreq() {
+	return tckFreq;
 }
 
-bool Jtag::navigateToState(Jtag_fsm::State init, Jtag_fsm::State dest) {
-	FT_STATUS ftStatus;
-	BYTE byOutputBuffer[3]; // Buffer to hold MPSSE commands and data to be sent to the FT2232H
-	DWORD dwNumBytesSent = 0; // Count of actual bytes sent - used with FT_Write
+// Serial number of the connected FTDI chip, empty if it can't be read
+string Jtag::getSerialNumber() {
+	return UsbTuner::serialNumber(ftHandle);
+}
 
-	Jtag_fsm::Transistions transistions = Jtag_fsm::getTransitions(init, dest);
+// Moves from the tracked state to dest. The moves are merged with any others pending.
+bool Jtag::navigateToState(Jtag_fsm::State dest) {
+	Jtag_fsm::Transistions transistions = Jtag_fsm::getTransitions(
+			currentState, dest);
 
-	if (transistions.moves > 0) {
-		if (transistions.moves < 8) {
-			byOutputBuffer[0] = 0x4B;
-			byOutputBuffer[1] = transistions.moves - 1;
-			byOutputBuffer[2] = 0x7f & transistions.tms;
-			ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-			if (ftStatus != FT_OK)
-				return false;
-		} else {
-			cout << "Transition of 8 moves!" << endl;
-			byOutputBuffer[0] = 0x4B;
-			byOutputBuffer[1] = 6;
-			byOutputBuffer[2] = 0x7f & transistions.tms;
-			ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-			if (ftStatus != FT_OK)
-				return false;
-			byOutputBuffer[0] = 0x4B;
-			byOutputBuffer[1] = transistions.moves - 8;
-			byOutputBuffer[2] = 0x7f & (transistions.tms >> 7);
-			ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-			if (ftStatus != FT_OK)
-				return false;
-		}
-	}
+	if (!queueTms(transistions.tms, transistions.moves))
+		return false;
+	currentState = dest;
 	return true;
 }
 
-bool Jtag::shiftData(unsigned int bitCount, string tdi, string tdo,
-		string mask) {
-	FT_STATUS ftStatus;
-	unsigned int reqBytes = bitCount / 8 + (bitCount % 8 > 0);
-	BYTE *byOutputBuffer = new BYTE[reqBytes + 3];
-	BYTE *tdoBuffer = new BYTE[reqBytes + 3];
-	BYTE *byInputBuffer = new BYTE[reqBytes + 6];
-	DWORD dwNumBytesSent = 0;
-	DWORD dwNumBytesToRead = 0;
-	DWORD dwNumBytesRead = 0;
-	DWORD tdoBytes = 0;
+// Five TMS high clocks reach TEST_LOGIC_RESET from any state
+bool Jtag::resetState() {
+	if (!queueTms(0x1F, 5))
+		return false;
+	currentState = Jtag_fsm::TEST_LOGIC_RESET;
+	return true;
+}
 
-	unsigned int reqHex = bitCount / 4 + (bitCount % 4 > 0);
+Jtag_fsm::State Jtag::getState() {
+	return currentState;
+}
 
-	if (tdi.length() < reqHex)
+// Shifts bitCount bits of tdi (zeros if tdi is NULL), reading TDO into tdo unless it's NULL
+bool Jtag::shiftData(unsigned int bitCount, const BYTE *tdi, BYTE *tdo,
+		BitBuffer::BitOrder order) {
+	if (!tdo)
+		return order == BitBuffer::LSB_FIRST ?
+				shift<WRITE, BitBuffer::LSB_FIRST>(bitCount, tdi, NULL) :
+				shift<WRITE, BitBuffer::MSB_FIRST>(bitCount, tdi, NULL);
+
+	unsigned int offset = 0;
+	return shiftData(bitCount, tdi,
+			[tdo, &offset](const BYTE *data, unsigned int count) {
+				copy(data, data + count, tdo + offset);
+				offset += count;
+				return true;
+			}, order);
+}
+
+// Shifts bitCount bits of tdi (zeros if tdi is NULL) and streams TDO into sink. The
+// read back is drained as it arrives so scans of any length fit in the FTDI buffers.
+bool Jtag::shiftData(unsigned int bitCount, const BYTE *tdi,
+		const TdoSink &sink, BitBuffer::BitOrder order) {
+	return order == BitBuffer::LSB_FIRST ?
+			shift<READ, BitBuffer::LSB_FIRST>(bitCount, tdi, &sink) :
+			shift<READ, BitBuffer::MSB_FIRST>(bitCount, tdi, &sink);
+}
+
+// The shift engine, built once per mode and bit order so the framing has no
+// runtime branches on either. WRITE queues the scan without reading TDO, READ
+// streams TDO into sink as it arrives and CHECK queues the reads for
+// resolveChecks() to drain.
+template<Jtag::ShiftMode mode, BitBuffer::BitOrder order>
+bool Jtag::shift(unsigned int bitCount, const BYTE *tdi,
+		const TdoSink *sink) {
+	const bool read = mode != WRITE;
+	const BYTE sendImmediate = 0x87;
+
+	// deferred checks are ahead of a streamed scan in the read queue
+	if (mode == READ && !checks.empty() && !resolveChecks())
 		return false;
-	bool read = tdo != "";
-	if (read) {
-		if (tdo.length() < reqHex) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			return false;
-		}
-		if (mask != "" && mask.length() < reqHex) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			return false;
-		}
-	}
 
-	if (!flush())
+	if (!startShift(bitCount))
 		return false;
 
-	if (bitCount < 9) {
-		int data = stoi(tdi, 0, 16);
-		byOutputBuffer[0] = read ? 0x3B : 0x1B;
-		byOutputBuffer[1] = bitCount - 2;
-		byOutputBuffer[2] = data & 0xff;
-		ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-		if (ftStatus != FT_OK) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			return false;
+	// with no devices after this one its last bit leaves the shift state, otherwise the
+	// trailer's last bit does. The rest is shifted as full bytes followed by the partial bits.
+	bool exits = trailerBits() == 0;
+	unsigned int fullBytes = (bitCount - exits) / 8;
+	unsigned int partialBits = (bitCount - exits) % 8;
+	BYTE lastByte = tdi && (partialBits > 0 || exits) ? tdi[fullBytes] : 0;
+	bool ok = writePad<order>(headerBits());
+
+	if (mode != READ) {
+		if (tdi) {
+			ok = ok && writeBytes<read, order>(tdi, fullBytes, true);
+		} else {
+			for (unsigned int sent = 0; ok && sent < fullBytes; sent += readChunk)
+				ok = writeBytes<read, order>(zeros,
+						min(fullBytes - sent, readChunk), true);
 		}
+		ok = ok && writeTail<read, order>(lastByte, partialBits, exits);
 
-		BYTE lastBit = (data >> ((bitCount - 1) % 8)) & 0x01;
+		// tdi is only valid until we return
+		return writer.release() && ok;
+	}
 
-		byOutputBuffer[0] = read ? 0x6E : 0x4E;
-		byOutputBuffer[1] = 0x00;
-		byOutputBuffer[2] = 0x03 | (lastBit << 7);
-		ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-		if (ftStatus != FT_OK) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			return false;
+	BufferPool::Buffer chunk = pool.get(min(fullBytes, readChunk));
+
+	unsigned int sent = 0;
+	unsigned int received = 0;
+	while (ok && received < fullBytes) {
+		// keep two chunks in flight so the MPSSE isn't left waiting on USB
+		while (ok && sent < fullBytes && sent - received < 2 * readChunk) {
+			unsigned int count = min(fullBytes - sent, readChunk);
+			ok = writeBytes<read, order>(tdi ? tdi + sent : zeros, count, true)
+					&& queueCommand(&sendImmediate, 1) && writer.submit();
+			sent += count;
 		}
 
-		if (read) {
-			do {
-				ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
-				// Get the number of bytes in the device input buffer
-			} while ((dwNumBytesToRead == 0) && (ftStatus == FT_OK));
-			//or Timeout
-			ftStatus = FT_Read(ftHandle, byInputBuffer, dwNumBytesToRead,
-					&dwNumBytesRead);
-			if (ftStatus != FT_OK) {
-				delete byOutputBuffer;
-				delete tdoBuffer;
-				delete byInputBuffer;
-				return false;
-			}
+		unsigned int count = min(fullBytes - received, readChunk);
+		ok = ok && rxEvent.read(chunk.data(), count, readTimeout)
+				&& (*sink)(chunk.data(), count);
+		received += count;
+	}
 
-			tdoBuffer[0] = byInputBuffer[0] >> (8 - (bitCount - 1));
-			tdoBuffer[0] |= byInputBuffer[1] >> (7 - (bitCount - 1));
-			tdoBytes = 1;
-		}
-	} else {
-		BYTE *tdiBytes = new BYTE[reqBytes + 1];
-		hexToByte(tdi, tdiBytes);
+	// tdi may be referenced by queued writes until they're out
+	if (!ok) {
+		writer.release();
+		return false;
+	}
 
-		unsigned int fullBytes = (bitCount - 1) / 8;
-		unsigned int remBytes = fullBytes;
-		unsigned int offset = 0;
+	if (!writeTail<read, order>(lastByte, partialBits, exits)) {
+		writer.release();
+		return false;
+	}
+	if (partialBits == 0 && !exits)
+		return true; // the scan ended on a byte boundary with nothing left to read
 
-		if (fullBytes > 65536 && read) {
-			cout << "Large transfers with reads may not work!" << endl;
-		}
+	if (!queueCommand(&sendImmediate, 1) || !sendCommands())
+		return false;
 
-		while (remBytes > 0) {
-			unsigned int bct = remBytes > 65536 ? 65536 : remBytes;
-			byOutputBuffer[0] = read ? 0x39 : 0x19;
-			byOutputBuffer[1] = (bct - 1) & 0xff;
-			byOutputBuffer[2] = ((bct - 1) >> 8) & 0xff;
-
-			for (unsigned int i = 0; i < bct; i++) {
-				byOutputBuffer[3 + i] = tdiBytes[i + offset];
-			}
-
-			ftStatus = FT_Write(ftHandle, byOutputBuffer, 3 + bct,
-					&dwNumBytesSent);
-			if (ftStatus != FT_OK) {
-				delete byOutputBuffer;
-				delete tdoBuffer;
-				delete byInputBuffer;
-				delete tdiBytes;
-				return false;
-			}
+	BYTE tail[2];
+	if (!rxEvent.read(tail, (partialBits > 0) + exits, readTimeout))
+		return false;
+	BYTE last = unpackLast(tail, partialBits, exits, lsbFlag(order));
+	return (*sink)(&last, 1);
+}
 
-			remBytes -= bct;
-			offset += bct;
-		}
+// Scans of up to 64 bits from an integer, bit 0 is shifted first
+bool Jtag::shiftData(unsigned int bitCount, uint64_t tdi, uint64_t *tdo) {
+	BYTE out[8];
+	BYTE in[8];
 
-		unsigned int partialBits = bitCount - 1 - (fullBytes * 8);
-
-		if (fullBytes * 8 + 1 != bitCount) {
-			byOutputBuffer[0] = read ? 0x3B : 0x1B;
-			byOutputBuffer[1] = partialBits - 1;
-			byOutputBuffer[2] = tdiBytes[reqBytes - 1] & 0xff;
-			ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-			if (ftStatus != FT_OK) {
-				delete byOutputBuffer;
-				delete tdoBuffer;
-				delete byInputBuffer;
-				delete tdiBytes;
-				return false;
-			}
-		}
+	if (bitCount > 64) {
+		cerr << "Integer scans are limited to 64 bits!" << endl;
+		return false;
+	}
 
-		BYTE lastBit = (tdiBytes[reqBytes - 1] >> ((bitCount - 1) % 8)) & 0x01;
-
-		byOutputBuffer[0] = read ? 0x6E : 0x4E;
-		byOutputBuffer[1] = 0x00;
-		byOutputBuffer[2] = 0x03 | (lastBit << 7);
-		ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-		if (ftStatus != FT_OK) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			delete tdiBytes;
-			return false;
-		}
+	for (unsigned int i = 0; i < 8; i++)
+		out[i] = tdi >> (i * 8);
 
-		if (read) {
-			DWORD bytesToRead = fullBytes
-					+ ((fullBytes * 8 + 1 != bitCount) ? 2 : 1);
-			do {
-				ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
-				// Get the number of bytes in the device input buffer
-			} while ((dwNumBytesToRead != bytesToRead) && (ftStatus == FT_OK));
-			//or Timeout
-			ftStatus = FT_Read(ftHandle, byInputBuffer, dwNumBytesToRead,
-					&dwNumBytesRead);
-			if (ftStatus != FT_OK) {
-				delete byOutputBuffer;
-				delete tdoBuffer;
-				delete byInputBuffer;
-				delete tdiBytes;
-				return false;
-			}
-
-			for (unsigned int i = 0; i < fullBytes; i++)
-				tdoBuffer[tdoBytes++] = byInputBuffer[i];
-
-			if (fullBytes * 8 + 1 != bitCount) {
-				tdoBuffer[tdoBytes] = byInputBuffer[tdoBytes]
-						>> (8 - partialBits);
-				tdoBuffer[tdoBytes++] |= byInputBuffer[dwNumBytesRead - 1]
-						>> (7 - partialBits);
-			} else {
-				tdoBuffer[tdoBytes++] = byInputBuffer[dwNumBytesRead - 1] >> 7;
-			}
-		}
+	if (!shiftData(bitCount, out, tdo ? in : NULL))
+		return false;
 
-		delete tdiBytes;
+	if (tdo) {
+		*tdo = 0;
+		for (unsigned int i = 0; i < (bitCount + 7) / 8; i++)
+			*tdo |= (uint64_t) in[i] << (i * 8);
+		if (bitCount < 64)
+			*tdo &= ((uint64_t) 1 << bitCount) - 1;
 	}
+	return true;
+}
 
-	if (read) {
-		//Read out the data from input buffer
-		std::stringstream ss;
-		for (int i = tdoBytes - 1; i >= 0; i--)
-			ss << setfill('0') << setw(2) << hex << (int) tdoBuffer[i];
-		string hexTdo = ss.str();
-		if (hexTdo.length() - 1 == mask.length())
-			hexTdo = hexTdo.substr(1, hexTdo.length() - 1);
-		if (!compareHexString(hexTdo, tdo, mask)) {
-			cerr << "TDO didn't match expected string. Got " << hexTdo
-					<< " expected " << tdo << " with mask " << mask << endl;
-
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			return false;
+bool Jtag::startShift(unsigned int bitCount) {
+	if (bitCount == 0)
+		return false;
 
-		}
+	if (currentState != Jtag_fsm::SHIFT_DR
+			&& currentState != Jtag_fsm::SHIFT_IR) {
+		cerr << "Jtag must be in SHIFT_DR or SHIFT_IR to shift data!" << endl;
+		return false;
 	}
 
-	delete byOutputBuffer;
-	delete tdoBuffer;
-	delete byInputBuffer;
-	return true;
+	// stale data can only be discarded if nothing is waiting to be read
+	return !checks.empty() || flush();
 }
 
-string Jtag::shiftData(unsigned int bitCount, string tdi) {
-	FT_STATUS ftStatus;
-	unsigned int reqBytes = bitCount / 8 + (bitCount % 8 > 0);
-	BYTE *byOutputBuffer = new BYTE[reqBytes + 3];
-	BYTE *tdoBuffer = new BYTE[reqBytes + 3];
-	BYTE *byInputBuffer = new BYTE[reqBytes + 6];
-	DWORD dwNumBytesSent = 0;
-	DWORD dwNumBytesToRead = 0;
-	DWORD dwNumBytesRead = 0;
-	DWORD tdoBytes = 0;
+// Number of bytes the MPSSE returns for a bitCount bit scan, exits is set if the scan's own last bit left the shift state
+DWORD Jtag::readLength(unsigned int bitCount, bool exits) {
+	unsigned int fullBytes = (bitCount - exits) / 8;
+	unsigned int partialBits = (bitCount - exits) % 8;
+	return fullBytes + (partialBits > 0) + exits;
+}
 
-	unsigned int reqHex = bitCount / 4 + (bitCount % 4 > 0);
+// Reassembles the bytes read back for a bitCount bit scan into tdo
+void Jtag::unpackRead(const BYTE *in, unsigned int bitCount, bool exits,
+		BYTE lsb, BYTE *tdo) {
+	unsigned int fullBytes = (bitCount - exits) / 8;
+	unsigned int partialBits = (bitCount - exits) % 8;
 
-	if (tdi.length() < reqHex)
-		return "";
+	copy(in, in + fullBytes, tdo);
+	if (partialBits > 0 || exits)
+		tdo[fullBytes] = unpackLast(in + fullBytes, partialBits, exits, lsb);
+}
 
-	if (!flush())
-		return "";
+// Builds the last byte of a scan from the partial bits read and, if the scan exited
+// on its own last bit, the read of the final TMS clock
+BYTE Jtag::unpackLast(const BYTE *in, unsigned int partialBits, bool exits,
+		BYTE lsb) {
+	// bit mode reads shift in from the MSB for LSB first and from the LSB for MSB first
+	BYTE partial = partialBits > 0 ? in[0] : 0;
+	if (!exits)
+		return lsb ? partial >> (8 - partialBits) : partial << (8 - partialBits);
+
+	BYTE tmsBit = in[partialBits > 0 ? 1 : 0] >> 7;
+	if (lsb)
+		return (partial >> (8 - partialBits)) | (tmsBit << partialBits);
+	return (partial << (8 - partialBits)) | (tmsBit << (7 - partialBits));
+}
 
-	if (bitCount < 9) {
-		int data = stoi(tdi, 0, 16);
-		byOutputBuffer[0] = 0x3B;
-		byOutputBuffer[1] = bitCount - 2;
-		byOutputBuffer[2] = data & 0xff;
-		ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-		if (ftStatus != FT_OK) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			return "";
-		}
+bool Jtag::shiftData(BitstreamSource &source, BitBuffer::BitOrder order) {
+	return order == BitBuffer::LSB_FIRST ?
+			shiftSource<BitBuffer::LSB_FIRST>(source) :
+			shiftSource<BitBuffer::MSB_FIRST>(source);
+}
 
-		BYTE lastBit = (data >> ((bitCount - 1) % 8)) & 0x01;
-
-		byOutputBuffer[0] = 0x6E;
-		byOutputBuffer[1] = 0x00;
-		byOutputBuffer[2] = 0x03 | (lastBit << 7);
-		ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-		if (ftStatus != FT_OK) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			return "";
-		}
+// Shifts the whole source out of TDI, pulling it from the source in MPSSE sized slices
+template<BitBuffer::BitOrder order>
+bool Jtag::shiftSource(BitstreamSource &source) {
+	const BYTE *slice;
 
-		do {
-			ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
-			// Get the number of bytes in the device input buffer
-		} while ((dwNumBytesToRead == 0) && (ftStatus == FT_OK));
-		//or Timeout
-		ftStatus = FT_Read(ftHandle, byInputBuffer, dwNumBytesToRead,
-				&dwNumBytesRead);
-		if (ftStatus != FT_OK) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			return "";
-		}
+	if (source.remaining() == 0)
+		return false;
 
-		tdoBuffer[0] = byInputBuffer[0] >> (8 - (bitCount - 1));
-		tdoBuffer[0] |= byInputBuffer[1] >> (7 - (bitCount - 1));
-		tdoBytes = 1;
+	if (currentState != Jtag_fsm::SHIFT_DR
+			&& currentState != Jtag_fsm::SHIFT_IR) {
+		cerr << "Jtag must be in SHIFT_DR or SHIFT_IR to shift data!" << endl;
+		return false;
+	}
 
-	} else {
-		BYTE *tdiBytes = new BYTE[reqBytes + 1];
-		hexToByte(tdi, tdiBytes);
+	if (checks.empty() && !flush())
+		return false;
 
-		unsigned int fullBytes = (bitCount - 1) / 8;
-		unsigned int remBytes = fullBytes;
-		unsigned int offset = 0;
+	bool exits = trailerBits() == 0;
+	size_t fullBytes = source.remaining() - exits;
+	bool ok = writePad<order>(headerBits());
+	while (ok && fullBytes > 0) {
+		size_t count = source.next(&slice,
+				fullBytes > 65536 ? 65536 : fullBytes);
+		// slices read with stdio are reused by the next call so only the mapping is referenced
+		ok = count > 0
+				&& writeBytes<false, order>(slice, count, source.isMapped());
+		fullBytes -= count;
+	}
 
-		if (fullBytes > 65536) {
-			cout << "Large transfers with reads may not work!" << endl;
-		}
+	if (exits)
+		ok = ok && source.next(&slice, 1) == 1
+				&& writeTail<false, order>(*slice, 7, true);
+	else
+		ok = ok && writeTail<false, order>(0, 0, false);
 
-		while (remBytes > 0) {
-			unsigned int bct = remBytes > 65536 ? 65536 : remBytes;
-			byOutputBuffer[0] = 0x39;
-			byOutputBuffer[1] = (bct - 1) & 0xff;
-			byOutputBuffer[2] = ((bct - 1) >> 8) & 0xff;
-
-			for (unsigned int i = 0; i < bct; i++) {
-				byOutputBuffer[3 + i] = tdiBytes[i + offset];
-			}
-
-			ftStatus = FT_Write(ftHandle, byOutputBuffer, 3 + bct,
-					&dwNumBytesSent);
-			if (ftStatus != FT_OK) {
-				delete byOutputBuffer;
-				delete tdoBuffer;
-				delete byInputBuffer;
-				delete tdiBytes;
-				return "";
-			}
-
-			remBytes -= bct;
-			offset += bct;
-		}
+	// the mapping goes away with the source
+	return writer.release() && ok;
+}
 
-		unsigned int partialBits = bitCount - 1 - (fullBytes * 8);
-
-		if (fullBytes * 8 + 1 != bitCount) {
-			byOutputBuffer[0] = 0x3B;
-			byOutputBuffer[1] = partialBits - 1;
-			byOutputBuffer[2] = tdiBytes[reqBytes - 1] & 0xff;
-			ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-			if (ftStatus != FT_OK) {
-				delete byOutputBuffer;
-				delete tdoBuffer;
-				delete byInputBuffer;
-				delete tdiBytes;
-				return "";
-			}
-		}
+// Frames count bytes into 64KB MPSSE byte shift commands. With borrow set, long
+// payloads are written straight from tdi, which must stay valid until writer.release().
+template<bool read, BitBuffer::BitOrder order>
+bool Jtag::writeBytes(const BYTE *tdi, unsigned int count, bool borrow) {
+	BYTE byOutputBuffer[3];
 
-		BYTE lastBit = (tdiBytes[reqBytes - 1] >> ((bitCount - 1) % 8)) & 0x01;
-
-		byOutputBuffer[0] = 0x6E;
-		byOutputBuffer[1] = 0x00;
-		byOutputBuffer[2] = 0x03 | (lastBit << 7);
-		ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-		if (ftStatus != FT_OK) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			delete tdiBytes;
-			return "";
-		}
+	if (!sendTms())
+		return false;
 
-		DWORD bytesToRead = fullBytes
-				+ ((fullBytes * 8 + 1 != bitCount) ? 2 : 1);
-		do {
-			ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
-			// Get the number of bytes in the device input buffer
-		} while ((dwNumBytesToRead != bytesToRead) && (ftStatus == FT_OK));
-		//or Timeout
-		ftStatus = FT_Read(ftHandle, byInputBuffer, dwNumBytesToRead,
-				&dwNumBytesRead);
-		if (ftStatus != FT_OK) {
-			delete byOutputBuffer;
-			delete tdoBuffer;
-			delete byInputBuffer;
-			delete tdiBytes;
-			return "";
-		}
+	unsigned int offset = 0;
+	while (count > 0) {
+		unsigned int bct = count > 65536 ? 65536 : count;
+		byOutputBuffer[0] = (read ? 0x31 : 0x11) | lsbFlag(order);
+		byOutputBuffer[1] = (bct - 1) & 0xff;
+		byOutputBuffer[2] = ((bct - 1) >> 8) & 0xff;
+
+		writer.buffer().insert(writer.buffer().end(), byOutputBuffer,
+				byOutputBuffer + 3);
+		if (borrow && bct >= minReference) {
+			writer.reference(tdi + offset, bct);
+			if (writer.size() >= transferSize && !writer.submit())
+				return false;
+		} else if (!queueCommand(tdi + offset, bct))
+			return false;
 
-		for (unsigned int i = 0; i < fullBytes; i++)
-			tdoBuffer[tdoBytes++] = byInputBuffer[i];
+		count -= bct;
+		offset += bct;
+	}
+	return true;
+}
 
-		if (fullBytes * 8 + 1 != bitCount) {
-			tdoBuffer[tdoBytes] = byInputBuffer[tdoBytes] >> (8 - partialBits);
-			tdoBuffer[tdoBytes++] |= byInputBuffer[dwNumBytesRead - 1]
-					>> (7 - partialBits);
-		} else {
-			tdoBuffer[tdoBytes++] = byInputBuffer[dwNumBytesRead - 1] >> 7;
-		}
+// Shifts partialBits bits of lastByte and leaves the shift state. If exits is set the bit
+// after the partial ones is the last, otherwise the trailer for the rest of the chain is.
+template<bool read, BitBuffer::BitOrder order>
+bool Jtag::writeTail(BYTE lastByte, unsigned int partialBits, bool exits) {
+	if (partialBits > 0 && !writeBits<read, order>(lastByte, partialBits))
+		return false;
 
-		delete tdiBytes;
+	if (exits) {
+		unsigned int lastShift =
+				order == BitBuffer::LSB_FIRST ? partialBits : 7 - partialBits;
+		return writeExit<read, order>((lastByte >> lastShift) & 0x01);
 	}
 
-	//Read out the data from input buffer
-	std::stringstream ss;
-	for (int i = tdoBytes - 1; i >= 0; i--)
-		ss << setfill('0') << setw(2) << hex << (int) tdoBuffer[i];
-	string hexTdo = ss.str();
-	if (hexTdo.length() - 1 == tdi.length())
-		hexTdo = hexTdo.substr(1, hexTdo.length() - 1);
+	// the other devices' bits are never read
+	BYTE fill = padFill();
+	return writePad<order>(trailerBits() - 1)
+			&& writeExit<false, order>(fill & 0x01);
+}
 
-	delete byOutputBuffer;
-	delete tdoBuffer;
-	delete byInputBuffer;
-	return hexTdo;
+// Shifts count (1 to 8) bits of data without leaving the shift state
+template<bool read, BitBuffer::BitOrder order>
+bool Jtag::writeBits(BYTE data, unsigned int count) {
+	BYTE byOutputBuffer[3];
+	byOutputBuffer[0] = (read ? 0x33 : 0x13) | lsbFlag(order);
+	byOutputBuffer[1] = count - 1;
+	byOutputBuffer[2] = data;
+	return queueCommand(byOutputBuffer, 3);
 }
 
-bool Jtag::sendClocks(unsigned long cycles) {
+// Shifts the final bit with TMS high to leave the shift state. Without a read the
+// bit is left pending so the following moves share its TMS command.
+template<bool read, BitBuffer::BitOrder order>
+bool Jtag::writeExit(BYTE lastBit) {
+	currentState =
+			currentState == Jtag_fsm::SHIFT_IR ?
+					Jtag_fsm::EXIT1_IR : Jtag_fsm::EXIT1_DR;
+
+	if (!read)
+		return queueTms(0x01, 1, lastBit);
+
 	BYTE byOutputBuffer[3];
-	DWORD dwNumBytesSent;
-	FT_STATUS ftStatus;
+	byOutputBuffer[0] = 0x6E;
+	byOutputBuffer[1] = 0x00;
+	byOutputBuffer[2] = 0x03 | (lastBit << 7);
+	return queueCommand(byOutputBuffer, 3);
+}
 
-	if (cycles / 8 > 65536) {
-		if (!sendClocks(cycles - 65536 * 8))
+// Shifts bits of padding for the devices around the selected one without leaving the shift state
+template<BitBuffer::BitOrder order>
+bool Jtag::writePad(unsigned int bits) {
+	const BYTE *fill = padFill() ? ones.data() : zeros;
+
+	while (bits >= 8) {
+		unsigned int count = min(bits / 8, readChunk);
+		if (!writeBytes<false, order>(fill, count, true))
 			return false;
-		cycles = 65536 * 8;
+		bits -= count * 8;
 	}
+	return bits == 0 || writeBits<false, order>(fill[0], bits);
+}
+
+// Bits shifted ahead of the selected device's, for the devices between it and TDO
+unsigned int Jtag::headerBits() {
+	return currentState == Jtag_fsm::SHIFT_IR ? irHeader : drHeader;
+}
 
-	cycles /= 8;
+// Bits shifted after the selected device's, for the devices between TDI and it
+unsigned int Jtag::trailerBits() {
+	return currentState == Jtag_fsm::SHIFT_IR ? irTrailer : drTrailer;
+}
 
-	byOutputBuffer[0] = 0x8F;
-	byOutputBuffer[1] = (cycles - 1) & 0xff;
-	byOutputBuffer[2] = ((cycles - 1) >> 8) & 0xff;
-	ftStatus = FT_Write(ftHandle, byOutputBuffer, 3, &dwNumBytesSent);
-	if (ftStatus != FT_OK)
+// The other devices get all ones in their IR, which is BYPASS, and zeros in their bypass registers
+BYTE Jtag::padFill() {
+	return currentState == Jtag_fsm::SHIFT_IR ? 0xFF : 0x00;
+}
+
+// Sets how many bits of the chain are before and after the selected device. The
+// headers are for the devices between it and TDO, which are shifted first.
+void Jtag::setPadding(unsigned int irHeaderBits, unsigned int irTrailerBits,
+		unsigned int drHeaderBits, unsigned int drTrailerBits) {
+	irHeader = irHeaderBits;
+	irTrailer = irTrailerBits;
+	drHeader = drHeaderBits;
+	drTrailer = drTrailerBits;
+}
+
+// TDO is read into tdo's own storage, resized in place so a BitBuffer that's
+// reused scan after scan stops allocating once it has grown
+bool Jtag::shiftData(const BitBuffer &tdi, BitBuffer *tdo,
+		BitBuffer::BitOrder order) {
+	if (tdo)
+		tdo->resize(tdi.size());
+	return shiftData(tdi.size(), tdi.data(), tdo ? tdo->data() : NULL, order);
+}
+
+// Checks TDO against tdo where mask is set. With deferred checks the comparison
+// happens in resolveChecks() and name identifies the check if it fails.
+bool Jtag::shiftData(const BitBuffer &tdi, const BitBuffer &tdo,
+		const BitBuffer &mask, string name) {
+	PendingCheck check;
+	if (tdo.size() < tdi.size()
+			|| (!mask.empty() && mask.size() < tdi.size()))
 		return false;
 
-	return true;
+	check.name = name;
+	check.bitCount = tdi.size();
+	check.order = BitBuffer::LSB_FIRST;
+	check.exits = trailerBits() == 0;
+	check.tdo = pool.get(tdi.byteCount());
+	copy(tdo.data(), tdo.data() + tdi.byteCount(), check.tdo.data());
+	if (!mask.empty()) {
+		check.mask = pool.get(tdi.byteCount());
+		copy(mask.data(), mask.data() + tdi.byteCount(), check.mask.data());
+	}
+	check.capture = NULL;
+
+	// a check longer than one read chunk is read back on its own
+	if (deferChecks && readLength(check.bitCount, check.exits) <= readChunk)
+		return queueCheck(check, tdi.data());
+
+	BufferPool::Buffer captured = pool.get(tdi.byteCount());
+	if (!shiftData(tdi.size(), tdi.data(), captured.data()))
+		return false;
+	return checkTdo(check, captured.data());
 }
 
-bool Jtag::compareHexString(string a, string b, string mask) {
-	unsigned int length = a.length();
+// Shifts tdi and has resolveChecks() fill tdo with what came back, so scans
+// that only collect TDO can be queued back to back like deferred checks. This
+// defers whether or not setDeferChecks() is on and tdo must stay put until the
+// read is resolved.
+bool Jtag::deferRead(const BitBuffer &tdi, BitBuffer *tdo) {
+	PendingCheck check;
+	check.bitCount = tdi.size();
+	check.order = BitBuffer::LSB_FIRST;
+	check.exits = trailerBits() == 0;
+	check.capture = tdo;
+	tdo->resize(tdi.size());
+
+	if (readLength(check.bitCount, check.exits) > readChunk)
+		return shiftData(tdi.size(), tdi.data(), tdo->data());
+	return queueCheck(check, tdi.data());
+}
 
-	if (length != b.length()) {
-		cout << "length mismatch!" << endl;
+// Queues the scan for a deferred check, resolving the ones already queued
+// first if the reads would outgrow one chunk
+bool Jtag::queueCheck(PendingCheck &check, const BYTE *tdi) {
+	DWORD length = readLength(check.bitCount, check.exits);
+	if (pendingRead + length > readChunk && !resolveChecks())
+		return false;
+	if (!shift<CHECK, BitBuffer::LSB_FIRST>(check.bitCount, tdi, NULL))
+		return false;
+	checks.push_back(move(check));
+	pendingRead += length;
+	return true;
+}
+
+bool Jtag::checkTdo(const PendingCheck &check, const BYTE *captured) {
+	bool masked = check.mask.size() > 0;
+	unsigned int bit = BitBuffer::mismatch(captured, check.tdo.data(),
+			masked ? check.mask.data() : NULL, check.bitCount, check.order);
+	if (bit != check.bitCount) {
+		if (!check.name.empty())
+			cerr << check.name << " failed! ";
+		cerr << "TDO didn't match expected string at bit " << bit << ". Got "
+				<< BitBuffer(captured, check.bitCount).toHex() << " expected "
+				<< BitBuffer(check.tdo.data(), check.bitCount).toHex()
+				<< " with mask "
+				<< (masked ?
+						BitBuffer(check.mask.data(), check.bitCount).toHex() :
+						"") << endl;
 		return false;
 	}
+	return true;
+}
 
-	if (mask == "")
-		return a == b;
+// While set, TDO checks are queued with their scans and compared together in
+// resolveChecks(). Clearing it drops any checks that weren't resolved.
+void Jtag::setDeferChecks(bool defer) {
+	deferChecks = defer;
+	if (!defer)
+		discardChecks();
+}
 
-	if (length != mask.length()) {
-		cout << "length and mask mismatch! " << length << " and "
-				<< mask.length() << " of strings " << a << " and " << mask
-				<< endl;
+// Drops the deferred checks. Their TDO may still be queued in the FTDI or on its
+// way, so it's sent for and read back to keep it out of the next read.
+void Jtag::discardChecks() {
+	if (checks.empty())
+		return;
+
+	DWORD total = 0;
+	for (PendingCheck &check : checks)
+		total += readLength(check.bitCount, check.exits);
+	checks.clear();
+	pendingRead = 0;
+
+	BYTE sendImmediate = 0x87;
+	BufferPool::Buffer byInputBuffer = pool.get(total);
+	if (!queueCommand(&sendImmediate, 1) || !sendCommands()
+			|| !rxEvent.read(byInputBuffer.data(), total, readTimeout))
+		FT_Purge(ftHandle, FT_PURGE_RX);
+}
+
+// Reads back every deferred check with a single send immediate and compares them
+bool Jtag::resolveChecks() {
+	if (checks.empty())
+		return true;
+
+	DWORD total = 0;
+	for (PendingCheck &check : checks)
+		total += readLength(check.bitCount, check.exits);
+
+	BYTE sendImmediate = 0x87;
+	BufferPool::Buffer byInputBuffer = pool.get(total);
+	if (!queueCommand(&sendImmediate, 1) || !sendCommands()
+			|| !rxEvent.read(byInputBuffer.data(), total, readTimeout)) {
+		// whatever did arrive mustn't be read as the next scan's TDO
+		FT_Purge(ftHandle, FT_PURGE_RX);
+		checks.clear();
+		pendingRead = 0;
 		return false;
 	}
 
-	for (unsigned int i = 0; i < length / 2; i++) {
-		BYTE m = stoi(mask.substr(length - 2 - i * 2, 2), 0, 16);
-		BYTE pa = stoi(a.substr(length - 2 - i * 2, 2), 0, 16);
-		BYTE pb = stoi(b.substr(length - 2 - i * 2, 2), 0, 16);
-		if ((pa & m) != (pb & m)) {
-			cout << "Mismatch at " << i << endl;
-			return false;
+	bool passed = true;
+	DWORD offset = 0;
+	for (PendingCheck &check : checks) {
+		const BYTE *input = byInputBuffer.data() + offset;
+		BYTE flag = check.order == BitBuffer::LSB_FIRST ? 0x08 : 0x00;
+		offset += readLength(check.bitCount, check.exits);
+		if (check.capture) {
+			unpackRead(input, check.bitCount, check.exits, flag,
+					check.capture->data());
+			continue;
 		}
+		BufferPool::Buffer captured = pool.get((check.bitCount + 7) / 8);
+		unpackRead(input, check.bitCount, check.exits, flag, captured.data());
+		if (!checkTdo(check, captured.data()))
+			passed = false;
+	}
+	checks.clear();
+	pendingRead = 0;
+	return passed;
+}
+
+// Number of scratch buffers allocated so far, this stops growing once scans reuse the pool
+unsigned long Jtag::getAllocations() {
+	return pool.getAllocations();
+}
+
+// The session's scratch buffers, for bitstream sources read alongside its scans
+BufferPool& Jtag::getPool() {
+	return pool;
+}
+
+bool Jtag::shiftData(unsigned int bitCount, string tdi, string tdo,
+		string mask) {
+	unsigned int reqHex = bitCount / 4 + (bitCount % 4 > 0);
+
+	if (tdi.length() < reqHex)
+		return false;
 
+	if (tdo == "")
+		return shiftData(BitBuffer::fromHex(tdi, bitCount), NULL);
+
+	if (tdo.length() < reqHex || (mask != "" && mask.length() < reqHex))
+		return false;
+
+	return shiftData(BitBuffer::fromHex(tdi, bitCount),
+			BitBuffer::fromHex(tdo, bitCount),
+			mask == "" ? BitBuffer() : BitBuffer::fromHex(mask, bitCount));
+}
+
+string Jtag::shiftData(unsigned int bitCount, string tdi) {
+	unsigned int reqHex = bitCount / 4 + (bitCount % 4 > 0);
+	BitBuffer tdo;
+
+	if (tdi.length() < reqHex)
+		return "";
+
+	if (!shiftData(BitBuffer::fromHex(tdi, bitCount), &tdo))
+		return "";
+
+	return tdo.toHex();
+}
+
+
+bool Jtag::sendClocks(unsigned long cycles) {
+	BYTE byOutputBuffer[3];
+
+	// TMS holds its last value while clocking so only park in a state that loops on it
+	if (currentState != Jtag_fsm::TEST_LOGIC_RESET
+			&& currentState != Jtag_fsm::RUN_TEST_IDLE
+			&& currentState != Jtag_fsm::PAUSE_DR
+			&& currentState != Jtag_fsm::PAUSE_IR
+			&& !navigateToState(Jtag_fsm::RUN_TEST_IDLE))
+		return false;
+
+	// whole bytes of clocks first, up to 65536 bytes per command
+	while (cycles >= 8) {
+		unsigned long bytes = cycles / 8 > 65536 ? 65536 : cycles / 8;
+		byOutputBuffer[0] = 0x8F;
+		byOutputBuffer[1] = (bytes - 1) & 0xff;
+		byOutputBuffer[2] = ((bytes - 1) >> 8) & 0xff;
+		if (!queueCommand(byOutputBuffer, 3))
+			return false;
+		cycles -= bytes * 8;
 	}
-	if ((length & 1) != 0) {
-		BYTE m = stoi(mask.substr(0, 1), 0, 16);
-		BYTE pa = stoi(a.substr(0, 1), 0, 16);
-		BYTE pb = stoi(b.substr(0, 1), 0, 16);
-		if ((pa & m) != (pb & m)) {
-			cout << "Mismatch at last bit" << endl;
+
+	if (cycles > 0) {
+		byOutputBuffer[0] = 0x8E;
+		byOutputBuffer[1] = cycles - 1;
+		if (!queueCommand(byOutputBuffer, 2))
 			return false;
-		}
 	}
 
 	return true;
 }
 
-void Jtag::hexToByte(string hex, BYTE* out) {
-	int length = hex.length();
-	for (int i = 0; i < length / 2; i++) {
-		try {
-			out[i] = stoi(hex.substr(length - 2 - i * 2, 2), 0, 16);
-		} catch (exception& e) {
-			cerr << "Failed at " << i << " with length " << length << endl;
-			cerr.flush();
-			exit(2);
-		}
+// Adds a command to the queue, handing the queue to the writer once it reaches the USB transfer size
+bool Jtag::queueCommand(const BYTE *command, unsigned int length) {
+	if (!sendTms())
+		return false;
+
+	vector<BYTE> &commands = writer.buffer();
+	commands.insert(commands.end(), command, command + length);
+	if (writer.size() >= transferSize)
+		return writer.submit();
+	return true;
+}
+
+// Adds count TMS bits (LSB first) to the pending moves. A tdi of 0 or 1 sets the
+// value TDI must hold, which is only needed for the final bit of a shift.
+bool Jtag::queueTms(BYTE tms, unsigned int count, int tdi) {
+	if (tdi >= 0) {
+		if (tmsTdiFixed && tmsTdi != tdi && !sendTms())
+			return false;
+		tmsTdi = tdi;
+		tmsTdiFixed = true;
 	}
-	if ((length & 1) != 0)
-		try {
-			out[length / 2] = stoi(hex.substr(0, 1), 0, 16);
-		} catch (exception& e) {
-			cerr << "Failed to convert string " << hex.substr(0, 1)
-					<< " to an int!" << endl;
-			cerr.flush();
-			exit(2);
-		}
+
+	for (unsigned int i = 0; i < count; i++) {
+		tmsBits |= ((tms >> i) & 0x01) << tmsCount;
+		// TMS commands can only clock out 7 bits at a time
+		if (++tmsCount == 7 && !sendTms())
+			return false;
+	}
+	return true;
+}
+
+// Queues the pending TMS moves as a single command
+bool Jtag::sendTms() {
+	if (tmsCount == 0)
+		return true;
+
+	BYTE byOutputBuffer[3];
+	byOutputBuffer[0] = 0x4B;
+	byOutputBuffer[1] = tmsCount - 1;
+	byOutputBuffer[2] = tmsBits | (tmsTdi << 7);
+	tmsBits = 0;
+	tmsCount = 0;
+	tmsTdi = 0;
+	tmsTdiFixed = false;
+	return queueCommand(byOutputBuffer, 3);
+}
+
+// Sends everything queued and waits for it to be written
+bool Jtag::sendCommands() {
+	return sendTms() && writer.submit() && writer.wait();
 }
 
 bool Jtag::flush() {
@@ -769,13 +972,16 @@ bool Jtag::flush() {
 	ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
 	if (ftStatus != FT_OK)
 		return false;
-	if (dwNumBytesToRead == 0)
-		return true;
 
-//or Timeout
-	ftStatus = FT_Read(ftHandle, &byInputBuffer, dwNumBytesToRead,
-			&dwNumBytesRead);
-	if (ftStatus != FT_OK)
-		return false;
+	// streamed reads can leave more than the buffer holds
+	while (dwNumBytesToRead > 0) {
+		DWORD count = min(dwNumBytesToRead, (DWORD) sizeof(byInputBuffer));
+		ftStatus = FT_Read(ftHandle, &byInputBuffer, count, &dwNumBytesRead);
+		if (ftStatus != FT_OK)
+			return false;
+		if (dwNumBytesRead == 0)
+			break;
+		dwNumBytesToRead -= min(dwNumBytesRead, dwNumBytesToRead);
+	}
 	return true;
 }
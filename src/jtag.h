@@ -10,30 +10,122 @@
 
 #include "ftd2xx.h"
 #include "jtag_fsm.h"
+#include "bit_buffer.h"
+#include "bitstream_source.h"
+#include "usb_writer.h"
+#include "rx_event.h"
+#include "usb_tuner.h"
+#include "buffer_pool.h"
 #include <unistd.h>
+#include <vector>
+#include <functional>
 
 class Jtag {
+	// An expected TDO value whose scan has been queued but not read back yet
+	class PendingCheck {
+	public:
+		string name;
+		unsigned int bitCount;
+		BitBuffer::BitOrder order;
+		bool exits; // no trailer, the scan's own last bit left the shift state
+		BufferPool::Buffer tdo;
+		BufferPool::Buffer mask; // empty to compare every bit
+		BitBuffer *capture; // set to receive TDO instead of comparing it
+	};
+
 	FT_HANDLE ftHandle;
 	unsigned int uiDevIndex = 0xF; // The device in the list that is used
 	bool active;
+	UsbWriter writer; // Queues MPSSE commands and writes them on its own thread
+	unsigned int transferSize; // Queued commands are sent once they reach this size
+	RxEvent rxEvent; // Sleeps until read data arrives
+	unsigned int readTimeout; // ms to wait for read data
+	double tckFreq; // TCK rate set by the last divisor
+	Jtag_fsm::State currentState; // TAP state once everything queued has been clocked
+	BYTE tmsBits; // TMS moves not yet queued, merged into one command
+	unsigned int tmsCount;
+	BYTE tmsTdi; // TDI value held while the pending TMS bits are clocked
+	bool tmsTdiFixed; // the pending bits end a shift so tmsTdi can't change
+	BufferPool pool; // Scratch buffers for scans and checks, declared before anything holding them
+	bool deferChecks; // queue TDO checks until resolveChecks() instead of reading each one
+	vector<PendingCheck> checks;
+	DWORD pendingRead; // bytes the deferred checks will read back
+	unsigned int irHeader; // padding for the other devices in the chain, see setPadding()
+	unsigned int irTrailer;
+	unsigned int drHeader;
+	unsigned int drTrailer;
 
 public:
+	// Receives TDO in order as it's read back, returning false stops the scan
+	typedef function<bool(const BYTE*, unsigned int)> TdoSink;
+
 	Jtag();
 	FT_STATUS connect(unsigned int);
 	FT_STATUS disconnect();
 	bool initialize();
 	bool setFreq(double);
-	bool navigateToState(Jtag_fsm::State, Jtag_fsm::State);
+	double getFreq();
+	string getSerialNumber();
+	bool navigateToState(Jtag_fsm::State);
+	bool resetState();
+	Jtag_fsm::State getState();
+	void setPadding(unsigned int, unsigned int, unsigned int, unsigned int);
+	bool shiftData(unsigned int, const BYTE*, BYTE*, BitBuffer::BitOrder =
+			BitBuffer::LSB_FIRST);
+	bool shiftData(unsigned int, const BYTE*, const TdoSink&,
+			BitBuffer::BitOrder = BitBuffer::LSB_FIRST);
+	bool shiftData(const BitBuffer&, BitBuffer*, BitBuffer::BitOrder =
+			BitBuffer::LSB_FIRST);
+	bool shiftData(const BitBuffer&, const BitBuffer&, const BitBuffer&,
+			string = "");
+	bool deferRead(const BitBuffer&, BitBuffer*);
+	bool shiftData(BitstreamSource&, BitBuffer::BitOrder =
+			BitBuffer::LSB_FIRST);
+	bool shiftData(unsigned int, uint64_t, uint64_t*);
 	bool shiftData(unsigned int, string, string, string);
 	string shiftData(unsigned int, string);
 	bool sendClocks(unsigned long);
+	bool sendCommands();
+	void setDeferChecks(bool);
+	bool resolveChecks();
+	unsigned long getAllocations();
+	BufferPool& getPool();
 
 private:
+	enum ShiftMode {
+		WRITE, READ, CHECK
+	};
+
 	bool sync_mpsse();
 	bool config_jtag();
-	static void hexToByte(string, BYTE*);
 	bool flush();
-	bool compareHexString(string, string, string);
+	bool startShift(unsigned int);
+	void discardChecks();
+	template<ShiftMode, BitBuffer::BitOrder>
+	bool shift(unsigned int, const BYTE*, const TdoSink*);
+	template<BitBuffer::BitOrder>
+	bool shiftSource(BitstreamSource&);
+	static DWORD readLength(unsigned int, bool);
+	static void unpackRead(const BYTE*, unsigned int, bool, BYTE, BYTE*);
+	static BYTE unpackLast(const BYTE*, unsigned int, bool, BYTE);
+	static bool checkTdo(const PendingCheck&, const BYTE*);
+	bool queueCheck(PendingCheck&, const BYTE*);
+	bool queueCommand(const BYTE*, unsigned int);
+	bool queueTms(BYTE, unsigned int, int = -1);
+	bool sendTms();
+	template<bool, BitBuffer::BitOrder>
+	bool writeBytes(const BYTE*, unsigned int, bool);
+	template<bool, BitBuffer::BitOrder>
+	bool writeTail(BYTE, unsigned int, bool);
+	template<bool, BitBuffer::BitOrder>
+	bool writeBits(BYTE, unsigned int);
+	template<bool, BitBuffer::BitOrder>
+	bool writeExit(BYTE);
+	template<BitBuffer::BitOrder>
+	bool writePad(unsigned int);
+	unsigned int headerBits();
+	unsigned int trailerBits();
+	BYTE padFill();
 
 };
 
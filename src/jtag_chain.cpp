@@ -0,0 +1,252 @@
+/*
+ * jtag_chain.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "jtag_chain.h"
+#include <iostream>
+
+using namespace std;
+
+// IDCODEs of parts with a known IR length, ignoring the revision, and their
+// names as .bit files give them
+static const struct {
+	uint32_t idcode;
+	unsigned int irLength;
+	const char *name;
+} knownParts[] = {
+		{ 0x0362D093, 6, "7a35t" }, // Au
+		{ 0x0362C093, 6, "7a50t" },
+		{ 0x03632093, 6, "7a75t" },
+		{ 0x03631093, 6, "7a100t" }, // Au+
+		{ 0x03636093, 6, "7a200t" },
+		{ 0x03622093, 6, "7s6" },
+		{ 0x03620093, 6, "7s15" },
+		{ 0x037C4093, 6, "7s25" },
+		{ 0x0362F093, 6, "7s50" },
+};
+
+JtagChain::JtagChain(Jtag *dev) {
+	jtag = dev;
+}
+
+// Finds every device on the chain and selects the one closest to TDO
+bool JtagChain::scan() {
+	unsigned int count;
+	unsigned int irTotal;
+	BitBuffer captured;
+
+	devices.clear();
+	jtag->setPadding(0, 0, 0, 0);
+
+	if (!readIdcodes() || !readIrs(&irTotal, &captured)
+			|| !countDevices(&count))
+		return false;
+
+	if (count != devices.size()) {
+		cerr << "Found " << devices.size() << " devices by IDCODE but "
+				<< count << " in BYPASS!" << endl;
+		return false;
+	}
+	if (count == 0) {
+		cerr << "No devices found on the JTAG chain!" << endl;
+		return false;
+	}
+
+	if (!splitIrs(captured, irTotal))
+		return false;
+
+	return select(0);
+}
+
+// After reset each device has IDCODE (starting with a 1) or a single 0 bit BYPASS
+// selected. Shifting in ones marks the end of the chain with an all ones IDCODE.
+bool JtagChain::readIdcodes() {
+	const unsigned int bits = maxDevices * 32 + 32;
+	BitBuffer ones(bits);
+	BitBuffer tdo;
+
+	for (unsigned int i = 0; i < ones.byteCount(); i++)
+		ones.data()[i] = 0xFF;
+
+	if (!jtag->resetState() || !jtag->navigateToState(Jtag_fsm::SHIFT_DR)
+			|| !jtag->shiftData(ones, &tdo)
+			|| !jtag->navigateToState(Jtag_fsm::RUN_TEST_IDLE))
+		return false;
+
+	unsigned int pos = 0;
+	while (pos + 32 <= bits) {
+		Device device;
+		device.irLength = 0;
+		if (!tdo.getBit(pos)) {
+			device.idcode = 0;
+			pos++;
+		} else {
+			device.idcode = 0;
+			for (unsigned int i = 0; i < 32; i++)
+				device.idcode |= (uint32_t) tdo.getBit(pos + i) << i;
+			if (device.idcode == 0xFFFFFFFF)
+				return true;
+			pos += 32;
+		}
+		if (devices.size() == maxDevices)
+			break;
+		devices.push_back(device);
+	}
+
+	cerr << "JTAG chain is longer than " << maxDevices << " devices!" << endl;
+	return false;
+}
+
+// Counts the clocks a one takes to get through the chain with every device in BYPASS
+bool JtagChain::countDevices(unsigned int *count) {
+	return flood(Jtag_fsm::SHIFT_DR, maxDevices, count, NULL);
+}
+
+// Total IR length and the patterns the IRs captured. This leaves every IR all ones (BYPASS).
+bool JtagChain::readIrs(unsigned int *length, BitBuffer *captured) {
+	return flood(Jtag_fsm::SHIFT_IR, maxIrLength, length, captured);
+}
+
+// Shifts max zeros and then max ones through the register selected by state.
+// The first one comes out after length clocks, and whatever the register held
+// before is the first length bits read.
+bool JtagChain::flood(Jtag_fsm::State state, unsigned int max,
+		unsigned int *length, BitBuffer *captured) {
+	BitBuffer tdi(max * 2);
+	BitBuffer tdo;
+
+	for (unsigned int i = max / 8; i < tdi.byteCount(); i++)
+		tdi.data()[i] = 0xFF;
+
+	if (!jtag->navigateToState(state) || !jtag->shiftData(tdi, &tdo)
+			|| !jtag->navigateToState(Jtag_fsm::RUN_TEST_IDLE))
+		return false;
+
+	for (unsigned int i = max; i < max * 2; i++) {
+		if (tdo.getBit(i)) {
+			*length = i - max;
+			if (captured) {
+				*captured = BitBuffer(*length);
+				for (unsigned int j = 0; j < *length; j++)
+					captured->setBit(j, tdo.getBit(j));
+			}
+			return true;
+		}
+	}
+
+	cerr << "JTAG chain is broken or longer than " << max << " bits!" << endl;
+	return false;
+}
+
+// Works out each IR length. Known parts are looked up, a single unknown device gets
+// what's left and several are split where each captured IR starts with 1 then 0.
+bool JtagChain::splitIrs(const BitBuffer &captured, unsigned int total) {
+	unsigned int known = 0;
+	unsigned int unknown = 0;
+
+	for (Device &device : devices) {
+		device.irLength = knownIrLength(device.idcode);
+		known += device.irLength;
+		if (device.irLength == 0)
+			unknown++;
+	}
+
+	if (known + unknown > total) {
+		cerr << "IR lengths of the known parts don't fit in the " << total
+				<< " bit chain!" << endl;
+		return false;
+	}
+
+	unsigned int pos = 0;
+	for (unsigned int i = 0; i < devices.size(); i++) {
+		Device &device = devices[i];
+		if (device.irLength == 0) {
+			if (unknown == 1) {
+				device.irLength = total - known;
+			} else {
+				// this IR ends where the next capture pattern starts
+				unsigned int end = pos + 2;
+				while (end + 1 < captured.size()
+						&& !(captured.getBit(end) && !captured.getBit(end + 1)))
+					end++;
+				device.irLength = end - pos;
+			}
+			known += device.irLength;
+			unknown--;
+		}
+
+		if (pos + device.irLength > total || !captured.getBit(pos)
+				|| (device.irLength > 1 && captured.getBit(pos + 1))) {
+			cerr << "Couldn't work out the IR length of JTAG device " << i
+					<< "!" << endl;
+			return false;
+		}
+		pos += device.irLength;
+	}
+
+	if (pos != total) {
+		cerr << "IR lengths add up to " << pos << " bits but the chain has "
+				<< total << "!" << endl;
+		return false;
+	}
+	return true;
+}
+
+// Pads every scan so it only reaches device index
+bool JtagChain::select(unsigned int index) {
+	if (index >= devices.size())
+		return false;
+
+	unsigned int irHeader = 0;
+	unsigned int irTrailer = 0;
+	for (unsigned int i = 0; i < devices.size(); i++) {
+		if (i < index)
+			irHeader += devices[i].irLength;
+		else if (i > index)
+			irTrailer += devices[i].irLength;
+	}
+	jtag->setPadding(irHeader, irTrailer, index, devices.size() - index - 1);
+	return true;
+}
+
+// Index of the first device with the IDCODE, -1 if there isn't one
+int JtagChain::find(uint32_t idcode, uint32_t mask) {
+	for (unsigned int i = 0; i < devices.size(); i++)
+		if (devices[i].idcode != 0
+				&& (devices[i].idcode & mask) == (idcode & mask))
+			return i;
+	return -1;
+}
+
+// Index of the first known FPGA, -1 if there isn't one
+int JtagChain::findFpga() {
+	for (unsigned int i = 0; i < devices.size(); i++)
+		if (knownIrLength(devices[i].idcode) != 0)
+			return i;
+	return -1;
+}
+
+unsigned int JtagChain::size() {
+	return devices.size();
+}
+
+const JtagChain::Device& JtagChain::getDevice(unsigned int index) {
+	return devices[index];
+}
+
+unsigned int JtagChain::knownIrLength(uint32_t idcode) {
+	for (auto &part : knownParts)
+		if ((idcode & 0x0FFFFFFF) == part.idcode)
+			return part.irLength;
+	return 0;
+}
+
+// Name of a known part like 7a35t, empty if the IDCODE isn't one
+string JtagChain::partName(uint32_t idcode) {
+	for (auto &part : knownParts)
+		if ((idcode & 0x0FFFFFFF) == part.idcode)
+			return part.name;
+	return "";
+}
@@ -0,0 +1,56 @@
+/*
+ * jtag_chain.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef JTAG_CHAIN_H_
+#define JTAG_CHAIN_H_
+
+#include "jtag.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Enumerates the devices on the scan chain and points Jtag at one of them.
+ * Device 0 is the one closest to TDO. The IDCODEs come from the DR scan after
+ * reset, the device count from a BYPASS scan and the IR lengths from known
+ * parts or the 01 pattern every IR captures. Once a device is selected Jtag
+ * pads every scan with BYPASS bits for the rest so callers see a single TAP.
+ */
+class JtagChain {
+public:
+	class Device {
+	public:
+		uint32_t idcode; // 0 if the device has no IDCODE register
+		unsigned int irLength;
+	};
+
+	JtagChain(Jtag*);
+	bool scan();
+	bool select(unsigned int);
+	int find(uint32_t, uint32_t = 0x0FFFFFFF);
+	int findFpga();
+	unsigned int size();
+	const Device& getDevice(unsigned int);
+	static string partName(uint32_t);
+
+private:
+	static const unsigned int maxDevices = 32;
+	static const unsigned int maxIrLength = 1024;
+
+	Jtag *jtag;
+	vector<Device> devices;
+
+	bool readIdcodes();
+	bool countDevices(unsigned int*);
+	bool readIrs(unsigned int*, BitBuffer*);
+	bool splitIrs(const BitBuffer&, unsigned int);
+	bool flood(Jtag_fsm::State, unsigned int, unsigned int*, BitBuffer*);
+	static unsigned int knownIrLength(uint32_t);
+};
+
+#endif /* JTAG_CHAIN_H_ */
@@ -6,12 +6,11 @@
  */
 
 #include "jtag_fsm.h"
-#include <queue>
 #include <iostream>
 
 using namespace std;
 
-Jtag_fsm::State Jtag_fsm::getTransition(State state, bool tms) {
+constexpr Jtag_fsm::State Jtag_fsm::getTransition(State state, bool tms) {
 	switch (state) {
 	case TEST_LOGIC_RESET:
 		return tms ? TEST_LOGIC_RESET : RUN_TEST_IDLE;
@@ -50,33 +49,43 @@ Jtag_fsm::State Jtag_fsm::getTransition(State state, bool tms) {
 	return TEST_LOGIC_RESET;
 }
 
-Jtag_fsm::Transistions Jtag_fsm::getTransitions(State init, State final) {
-	queue<Transistions> queue;
-	Transistions t;
-	t.currentState = init;
-	t.moves = 0;
-	t.tms = 0;
-	queue.push(t);
-	while (!queue.empty()) {
-		t = queue.front();
-		queue.pop();
-		if (t.currentState == final) {
-			break;
-		}
-
-		State s0 = getTransition(t.currentState, false);
-		State s1 = getTransition(t.currentState, true);
+// Shortest TMS sequence between every pair of states, found with a breadth-first search at compile time
+struct Jtag_fsm::PathTable {
+	uint8_t tms[16][16];
+	uint8_t moves[16][16];
 
-		t.moves++;
-		t.tms &= ~(1 << (t.moves-1)); // clear bit
-		t.currentState = s0;
-		queue.push(t);
-
-		t.tms |= (1 << (t.moves-1));
-		t.currentState = s1;
-		queue.push(t);
+	constexpr PathTable() :
+			tms(), moves() {
+		for (int init = 0; init < 16; init++) {
+			bool visited[16] = { };
+			int queue[16] = { };
+			int head = 0;
+			int tail = 0;
+			queue[tail++] = init;
+			visited[init] = true;
+			while (head < tail) {
+				int state = queue[head++];
+				for (int bit = 0; bit < 2; bit++) {
+					int next = getTransition((State) state, bit);
+					if (visited[next])
+						continue;
+					visited[next] = true;
+					moves[init][next] = moves[init][state] + 1;
+					tms[init][next] = tms[init][state]
+							| (bit << moves[init][state]);
+					queue[tail++] = next;
+				}
+			}
+		}
 	}
+};
 
+Jtag_fsm::Transistions Jtag_fsm::getTransitions(State init, State final) {
+	static constexpr PathTable paths;
+	Transistions t;
+	t.currentState = final;
+	t.tms = paths.tms[init][final];
+	t.moves = paths.moves[init][final];
 	return t;
 }
 
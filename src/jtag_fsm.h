@@ -43,9 +43,9 @@ public:
 	static Transistions getTransitions(State, State);
 	static State getStateFromName(string);
 
-
 private:
-	static State getTransition(State, bool);
+	struct PathTable;
+	static constexpr State getTransition(State, bool);
 
 };
 
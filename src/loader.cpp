@@ -14,6 +14,10 @@
 #include <unistd.h>
 #include <chrono>
 #include "config_type.h"
+#include "bit_file.h"
+#include "config_packets.h"
+#include "config_registers.h"
+#include "jtag_chain.h"
 #ifdef _WIN32
 #include "mingw.thread.h"
 #else
@@ -23,43 +27,104 @@
 
 using namespace std;
 
+// TCK used for configuration unless a calibrated rate is set
+static const double defaultFreq = 10000000;
+// The bridge firmware isn't clocked any faster than this
+static const double bridgeFreq = 1500000;
+// Longest the configuration memory takes to clear after JPROGRAM, in ms
+static const unsigned int clearTimeout = 1000;
+// Longest a flash erase takes through the bridge, in ms
+static const unsigned int eraseTimeout = 60000;
+// Longest the last page program after a flash write takes, in ms
+static const unsigned int programTimeout = 1000;
+// Polls start 1 ms apart and back off to this
+static const unsigned int maxPollWait = 64;
+
 Loader::Loader(Jtag *dev) {
 	device = dev;
-	currentState = Jtag_fsm::TEST_LOGIC_RESET;
+	tckFreq = defaultFreq;
 }
-bool Loader::setState(Jtag_fsm::State state) {
-	if (!device->navigateToState(currentState, state))
-		return false;
-	currentState = state;
-	return true;
 
+// Sets the TCK rate used from here on, the bridge is capped at its own limit
+void Loader::setFreq(double freq) {
+	tckFreq = freq;
 }
 
-bool Loader::resetState() {
-	currentState = Jtag_fsm::TEST_LOGIC_RESET;
-	return device->navigateToState(Jtag_fsm::CAPTURE_DR,
-			Jtag_fsm::TEST_LOGIC_RESET);
+double Loader::getFreq() {
+	return tckFreq;
 }
 
-bool Loader::setIR(Instruction inst) {
-	stringstream inst_str;
-	inst_str << std::setfill('0') << std::setw(2) << hex
-			<< static_cast<int>(inst);
+// Walks TCK up from the bridge rate, checking each step with IDCODE and a BYPASS
+// pattern scan. The rate one step below the fastest that passed is kept as a
+// margin, 0 is returned if even the slowest step fails.
+double Loader::calibrateFreq() {
+	// divisors of the MPSSE 30 MHz clock, the rates are 1.5, 2, 3, 5, 6, 7.5, 10, 15 and 30 MHz
+	static const unsigned int divisors[] = { 19, 14, 9, 5, 4, 3, 2, 1, 0 };
+	static const int steps = sizeof(divisors) / sizeof(divisors[0]);
+
+	// every step has to read the same IDCODE as the slowest one
+	uint64_t idcode;
+	if (!device->setFreq(30000000.0 / (divisors[0] + 1)) || !resetState()
+			|| !shiftDR(IDCODE, 32, 0, &idcode))
+		return 0;
+	if ((idcode & 0x01) == 0 || idcode == 0xFFFFFFFF) // bit 0 of a real IDCODE is always set
+		return 0;
+
+	int fastest = -1;
+	for (int i = 0; i < steps; i++) {
+		if (!device->setFreq(30000000.0 / (divisors[i] + 1)))
+			return 0;
+		if (!checkFreq(idcode))
+			break;
+		fastest = i;
+	}
 
-	if (!device->navigateToState(currentState, Jtag_fsm::SHIFT_IR)) {
-		cerr << "Failed to change to SHIFT_IR state!" << endl;
+	if (!resetState() || !device->sendCommands())
+		return 0;
+	if (fastest < 0)
+		return 0;
+
+	tckFreq = 30000000.0 / (divisors[fastest > 0 ? fastest - 1 : 0] + 1);
+	return tckFreq;
+}
+
+// Checks the link at the current TCK. BYPASS delays TDI by one clock so every
+// bit of the pattern has to come back one position later.
+bool Loader::checkFreq(uint64_t expectedIdcode) {
+	const unsigned int bits = 4096;
+	uint64_t idcode;
+
+	if (!resetState() || !shiftDR(IDCODE, 32, 0, &idcode))
 		return false;
-	}
-	if (!device->shiftData(6, inst_str.str(), "", "")) {
-		cerr << "Failed to shift instruction data!" << endl;
+	if (idcode != expectedIdcode)
 		return false;
+
+	BitBuffer pattern(bits + 1);
+	for (unsigned int i = 0; i < pattern.byteCount(); i++)
+		pattern.data()[i] = i % 4 == 0 ? 0x55 : i % 4 == 1 ? 0x0F : i * 37;
+	BitBuffer expected(bits + 1);
+	BitBuffer mask(bits + 1);
+	for (unsigned int i = 1; i <= bits; i++) {
+		expected.setBit(i, pattern.getBit(i - 1));
+		mask.setBit(i, true);
 	}
-	if (!device->navigateToState(Jtag_fsm::EXIT1_IR, Jtag_fsm::RUN_TEST_IDLE)) {
-		cerr << "Failed to change to RUN_TEST_IDLE state!" << endl;
+
+	BitBuffer read;
+	if (!setIR(BYPASS) || !shiftDR(pattern, &read))
 		return false;
-	}
-	currentState = Jtag_fsm::RUN_TEST_IDLE;
-	return true;
+	return BitBuffer::compare(read.data(), expected.data(), mask.data(),
+			bits + 1);
+}
+bool Loader::setState(Jtag_fsm::State state) {
+	return device->navigateToState(state);
+}
+
+bool Loader::resetState() {
+	return device->resetState();
+}
+
+bool Loader::setIR(Instruction inst) {
+	return shiftIR(6, inst, NULL);
 }
 
 // basically the same as shiftDR but ignores the first four bits
@@ -78,70 +143,229 @@ bool Loader::shiftUDR(int bits, string write, string read, string mask) {
 	return shiftDR(bits, uwrite, uread, umask);
 }
 
-bool Loader::shiftDR(int bits, string write, string read, string mask) {
-	if (!device->navigateToState(currentState, Jtag_fsm::SHIFT_DR)) {
+bool Loader::shiftDR(const BitBuffer &write, BitBuffer *read,
+		BitBuffer::BitOrder order) {
+	if (!device->navigateToState(Jtag_fsm::SHIFT_DR)) {
 		cerr << "Failed to change to SHIFT_DR state!" << endl;
 		return false;
 	}
-	if (!device->shiftData(bits, write, read, mask)) {
+	if (!device->shiftData(write, read, order)) {
 		cerr << "Failed to shift data!" << endl;
 		return false;
 	}
-	if (!device->navigateToState(Jtag_fsm::EXIT1_DR, Jtag_fsm::RUN_TEST_IDLE)) {
-		cerr << "Failed to change to RUN_TEST_IDLE state!" << endl;
+	// update commits the scan, the next navigation carries on from here
+	if (!device->navigateToState(Jtag_fsm::UPDATE_DR)) {
+		cerr << "Failed to change to UPDATE_DR state!" << endl;
 		return false;
 	}
-	currentState = Jtag_fsm::RUN_TEST_IDLE;
 	return true;
 }
 
-bool Loader::shiftIR(int bits, string write, string read, string mask) {
-	if (!device->navigateToState(currentState, Jtag_fsm::SHIFT_IR)) {
-		cerr << "Failed to change to SHIFT_IR state!" << endl;
+bool Loader::shiftDR(const BitBuffer &write, const BitBuffer &read,
+		const BitBuffer &mask, string name) {
+	if (!device->navigateToState(Jtag_fsm::SHIFT_DR)) {
+		cerr << "Failed to change to SHIFT_DR state!" << endl;
 		return false;
 	}
-	if (!device->shiftData(bits, write, read, mask)) {
+	if (!device->shiftData(write, read, mask, name)) {
 		cerr << "Failed to shift data!" << endl;
 		return false;
 	}
-	if (!device->navigateToState(Jtag_fsm::EXIT1_IR, Jtag_fsm::RUN_TEST_IDLE)) {
-		cerr << "Failed to change to RUN_TEST_IDLE state!" << endl;
+	// update commits the scan, the next navigation carries on from here
+	if (!device->navigateToState(Jtag_fsm::UPDATE_DR)) {
+		cerr << "Failed to change to UPDATE_DR state!" << endl;
 		return false;
 	}
-	currentState = Jtag_fsm::RUN_TEST_IDLE;
 	return true;
 }
 
-string Loader::shiftDR(int bits, string write) {
-	if (!device->navigateToState(currentState, Jtag_fsm::SHIFT_DR)) {
+bool Loader::shiftDR(BitstreamSource &source, BitBuffer::BitOrder order) {
+	if (!device->navigateToState(Jtag_fsm::SHIFT_DR)) {
 		cerr << "Failed to change to SHIFT_DR state!" << endl;
-		return NULL;
+		return false;
+	}
+	if (!device->shiftData(source, order)) {
+		cerr << "Failed to shift data!" << endl;
+		return false;
+	}
+	// update commits the scan, the next navigation carries on from here
+	if (!device->navigateToState(Jtag_fsm::UPDATE_DR)) {
+		cerr << "Failed to change to UPDATE_DR state!" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool Loader::shiftIR(const BitBuffer &write, const BitBuffer &read,
+		const BitBuffer &mask, string name) {
+	if (!device->navigateToState(Jtag_fsm::SHIFT_IR)) {
+		cerr << "Failed to change to SHIFT_IR state!" << endl;
+		return false;
+	}
+	if (!device->shiftData(write, read, mask, name)) {
+		cerr << "Failed to shift data!" << endl;
+		return false;
+	}
+	// update commits the scan, the next navigation carries on from here
+	if (!device->navigateToState(Jtag_fsm::UPDATE_IR)) {
+		cerr << "Failed to change to UPDATE_IR state!" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool Loader::shiftDR(int bits, string write, string read, string mask,
+		string name) {
+	if (read.empty())
+		return shiftDR(BitBuffer::fromHex(write, bits), NULL);
+	return shiftDR(BitBuffer::fromHex(write, bits),
+			BitBuffer::fromHex(read, bits),
+			mask.empty() ? BitBuffer() : BitBuffer::fromHex(mask, bits), name);
+}
+
+bool Loader::shiftIR(int bits, string write, string read, string mask,
+		string name) {
+	return shiftIR(BitBuffer::fromHex(write, bits),
+			BitBuffer::fromHex(read, bits),
+			mask.empty() ? BitBuffer() : BitBuffer::fromHex(mask, bits), name);
+}
+
+bool Loader::shiftIR(int bits, uint64_t write, uint64_t *read) {
+	if (!device->navigateToState(Jtag_fsm::SHIFT_IR)) {
+		cerr << "Failed to change to SHIFT_IR state!" << endl;
+		return false;
+	}
+	if (!device->shiftData(bits, write, read)) {
+		cerr << "Failed to shift instruction data!" << endl;
+		return false;
+	}
+	if (!device->navigateToState(Jtag_fsm::UPDATE_IR)) {
+		cerr << "Failed to change to UPDATE_IR state!" << endl;
+		return false;
 	}
+	return true;
+}
 
-	string data = device->shiftData(bits, write);
-	if (data.empty()) {
+bool Loader::shiftDR(int bits, uint64_t write, uint64_t *read) {
+	if (!device->navigateToState(Jtag_fsm::SHIFT_DR)) {
+		cerr << "Failed to change to SHIFT_DR state!" << endl;
+		return false;
+	}
+	if (!device->shiftData(bits, write, read)) {
 		cerr << "Failed to shift data!" << endl;
-		return NULL;
+		return false;
+	}
+	if (!device->navigateToState(Jtag_fsm::UPDATE_DR)) {
+		cerr << "Failed to change to UPDATE_DR state!" << endl;
+		return false;
+	}
+	return true;
+}
+
+// Sets the instruction and scans the data register it selects. Both scans are
+// queued together so a read sends them in a single USB write.
+bool Loader::shiftDR(Instruction inst, int bits, uint64_t write,
+		uint64_t *read) {
+	return setIR(inst) && shiftDR(bits, write, read);
+}
+
+string Loader::shiftDR(int bits, string write) {
+	BitBuffer data;
+	if (!shiftDR(BitBuffer::fromHex(write, bits), &data))
+		return "";
+	return data.toHex();
+}
+
+// Opens a .bin or a .bit and checks it against the board before anything is
+// shifted: the part in a .bit header and the packets of the configuration
+// data itself. The source is left at the start of the configuration data.
+bool Loader::openBitstream(string file, BitstreamSource &bin,
+		ConfigPackets *packets) {
+	uint64_t idcode;
+	if (!bin.open(file)) {
+		cerr << "Failed to read bin file: " + file << endl;
+		return false;
+	}
+	if (!resetState() || !shiftDR(IDCODE, 32, 0, &idcode))
+		return false;
+
+	if (BitFile::hasHeader(bin)) {
+		BitFile header;
+		if (!header.read(bin))
+			return false;
+		cout << "Bit file " << header.design << " for " << header.part
+				<< " from " << header.date << " " << header.time << endl;
+		if (!checkPart(header.part, idcode))
+			return false;
 	}
-	if (!device->navigateToState(Jtag_fsm::EXIT1_DR, Jtag_fsm::RUN_TEST_IDLE)) {
-		cerr << "Failed to change to RUN_TEST_IDLE state!" << endl;
-		return NULL;
+
+	size_t start = bin.tell();
+	return packets->parse(bin) && packets->validate(idcode) && bin.seek(start);
+}
+
+// Compares the part an IDCODE belongs to with a .bit file's part, which starts
+// with the device name as in 7a35tftg256
+bool Loader::checkPart(string part, uint32_t idcode) {
+	string device = JtagChain::partName(idcode);
+	if (device.empty()) {
+		cerr << "Unknown IDCODE " << hex << setw(8) << setfill('0') << idcode
+				<< dec << ", can't check the part " << part << endl;
+		return true;
+	}
+
+	transform(part.begin(), part.end(), part.begin(), ::tolower);
+	if (part.compare(0, 2, "xc") == 0)
+		part.erase(0, 2);
+	if (part.compare(0, device.size(), device) != 0
+			|| (part.size() > device.size() && isdigit(part[device.size()]))) {
+		cerr << "The bit file is for " << part << " but the board has a "
+				<< device << "!" << endl;
+		return false;
 	}
-	currentState = Jtag_fsm::RUN_TEST_IDLE;
-	return data;
+	return true;
+}
+
+// Prints how far through the frame data the stream is as it's shifted
+void Loader::showProgress(BitstreamSource &bin, const ConfigPackets &packets) {
+	bin.setProgress([&packets, shown = -1](size_t position) mutable {
+		int percent = packets.frameProgress(position) * 100;
+		if (percent == shown)
+			return;
+		shown = percent;
+		cout << "\r" << percent << "%" << (percent == 100 ? "\n" : "") << flush;
+	});
 }
 
 bool Loader::loadBin(string file) {
-	string binStr = fileToBinStr(file);
+	BitstreamSource bin(device->getPool());
+	ConfigPackets packets;
 
-    if (binStr.empty()) {
-        cerr << "Failed to read bin file: "+ file << endl;
-        return false;
-    }
+	if (!openBitstream(file, bin, &packets))
+		return false;
+	showProgress(bin, packets);
+
+	// the status checks are read back together once everything is sent
+	BitBuffer statWord;
+	uint32_t stat;
+	device->setDeferChecks(true);
+	bool loaded = configure(bin, &statWord) && device->resolveChecks();
+	device->setDeferChecks(false);
 
-	string reversedBinStr = reverseBytes(binStr);
+	// a failed check stops before STAT is read so it's read again for the reason
+	if (loaded)
+		stat = registerValue(statWord);
+	else if (!readRegister(ConfigPackets::STAT, &stat))
+		return false;
+	string reason = ConfigRegisters::diagnose(stat);
+	if (!reason.empty()) {
+		cerr << "Configuration failed: " << reason << "!" << endl;
+		cerr << ConfigRegisters::describe(ConfigPackets::STAT, stat) << endl;
+	}
+	return loaded && reason.empty();
+}
 
-	if (!device->setFreq(10000000)) {
+bool Loader::configure(BitstreamSource &bin, BitBuffer *stat) {
+	if (!device->setFreq(tckFreq)) {
 		cerr << "Failed to set JTAG frequency!" << endl;
 		return false;
 	}
@@ -154,18 +378,20 @@ bool Loader::loadBin(string file) {
 		return false;
 	if (!setIR(ISC_NOOP))
 		return false;
-	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	if (!waitForInit())
+		return false;
 
 	// config/jprog/poll
 	if (!device->sendClocks(10000))
 		return false;
-	if (!shiftIR(6, "14", "11", "31"))
+	if (!shiftIR(6, "14", "11", "31", "INIT check after JPROGRAM"))
 		return false;
 
 	// config/slr
 	if (!setIR(CFG_IN))
 		return false;
-	if (!shiftDR(binStr.length() * 4, reversedBinStr, "", ""))
+	// the configuration logic expects each byte MSB first
+	if (!shiftDR(bin, BitBuffer::MSB_FIRST))
 		return false;
 
 	// config/start
@@ -179,21 +405,15 @@ bool Loader::loadBin(string file) {
 		return false;
 	if (!device->sendClocks(100))
 		return false;
-	if (!shiftIR(6, "09", "31", "11"))
+	if (!shiftIR(6, "09", "31", "11", "DONE check after JSTART"))
 		return false;
 
-	// config/status
+	// config/status, read back with the checks and decoded by the caller
 	if (!setState(Jtag_fsm::TEST_LOGIC_RESET))
 		return false;
 	if (!device->sendClocks(5))
 		return false;
-	if (!setIR(CFG_IN))
-		return false;
-	if (!shiftDR(160, "0000000400000004800700140000000466aa9955", "", ""))
-		return false;
-	if (!setIR(CFG_OUT))
-		return false;
-	if (!shiftDR(32, "00000000", "3f5e0d40", "08000000"))
+	if (!queueRead(ConfigPackets::STAT, stat))
 		return false;
 	if (!setState(Jtag_fsm::TEST_LOGIC_RESET))
 		return false;
@@ -203,28 +423,6 @@ bool Loader::loadBin(string file) {
 	return true;
 }
 
-string Loader::fileToBinStr(string file) {
-	ifstream binFile(file);
-	stringstream hexString;
-
-	char *buffer;
-	binFile.seekg(0, ios::end);
-	unsigned int byteCount = binFile.tellg();
-	binFile.seekg(0, ios::beg);
-	buffer = new char[byteCount];
-	binFile.read(buffer, byteCount);
-	binFile.close();
-
-	for (int i = byteCount - 1; i >= 0; i--) {
-		hexString << setfill('0') << setw(2) << std::hex
-				<< (int) ((unsigned char) buffer[i]);
-	}
-
-	delete buffer;
-
-	return hexString.str();
-}
-
 bool Loader::eraseFlash(string loaderFile) {
 	cout << "Initializing FPGA..." << endl;
 	if (!loadBin(loaderFile)) {
@@ -232,7 +430,7 @@ bool Loader::eraseFlash(string loaderFile) {
 		return false;
 	}
 
-	if (!device->setFreq(1500000)) {
+	if (!device->setFreq(min(tckFreq, bridgeFreq))) {
 		cerr << "Failed to set JTAG frequency!" << endl;
 		return false;
 	}
@@ -240,14 +438,12 @@ bool Loader::eraseFlash(string loaderFile) {
 	cout << "Erasing..." << endl;
 
 	// Erase the flash
-	if (!setIR(USER1))
+	if (!shiftDR(USER1, 1, 0, NULL))
 		return false;
 
-	if (!shiftDR(1, "0", "", ""))
+	if (!waitForFlash(eraseTimeout, "the flash erase"))
 		return false;
 
-	std::this_thread::sleep_for(std::chrono::seconds(1)); // wait for erase
-
 	if (!setIR(JPROGRAM))
 		return false;
 
@@ -255,12 +451,17 @@ bool Loader::eraseFlash(string loaderFile) {
 	if (!resetState())
 		return false;
 
-	return true;
+	return device->sendCommands();
 }
 
 bool Loader::writeBin(string binFile, bool flash, string loaderFile) {
 	if (flash) {
-		string binStr = fileToBinStr(binFile);
+		BitstreamSource bin(device->getPool());
+		ConfigPackets packets;
+
+		if (!openBitstream(binFile, bin, &packets))
+			return false;
+		showProgress(bin, packets);
 
 		cout << "Initializing FPGA..." << endl;
 		if (!loadBin(loaderFile)) {
@@ -268,7 +469,7 @@ bool Loader::writeBin(string binFile, bool flash, string loaderFile) {
 			return false;
 		}
 
-		if (!device->setFreq(1500000)) {
+		if (!device->setFreq(min(tckFreq, bridgeFreq))) {
 			cerr << "Failed to set JTAG frequency!" << endl;
 			return false;
 		}
@@ -276,21 +477,23 @@ bool Loader::writeBin(string binFile, bool flash, string loaderFile) {
 		cout << "Erasing..." << endl;
 
 		// Erase the flash
-		if (!setIR(USER1))
+		if (!shiftDR(USER1, 1, 0, NULL))
 			return false;
 
-		if (!shiftDR(1, "0", "", ""))
+		if (!waitForFlash(eraseTimeout, "the flash erase"))
 			return false;
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
 		cout << "Writing..." << endl;
 
 		// Write the flash
 		if (!setIR(USER2))
 			return false;
 
-		if (!shiftDR(binStr.length() * 4, binStr, "", ""))
+		if (!shiftDR(bin))
+			return false;
+
+		// the last page is still programming when the data's in
+		if (!waitForFlash(programTimeout, "the flash write"))
 			return false;
 
 		// If you enter the reset state after a write
@@ -302,7 +505,10 @@ bool Loader::writeBin(string binFile, bool flash, string loaderFile) {
 		if (!resetState())
 			return false;
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(100)); // 100ms delay is required before issuing JPROGRAM
+		// 100ms delay is required before issuing JPROGRAM, the bridge
+		// resetting the flash has nothing to poll
+		if (!sleep(100))
+			return false;
 
 		cout << "Resetting FPGA..." << endl;
 		// JPROGRAM resets the FPGA configuration and will
@@ -321,73 +527,366 @@ bool Loader::writeBin(string binFile, bool flash, string loaderFile) {
 	if (!resetState())
 		return false;
 
+	if (!device->sendCommands())
+		return false;
+
 	cout << "Done." << endl;
 	return true;
 }
 
-bool Loader::checkIDCODE() {
-	if (!setIR(IDCODE))
+// Reads the configuration frames back out of the FPGA after a RAM load and
+// compares them with the bitstream. Bits set in the mask file (a .msk from
+// write_bitstream -mask_file) change while the design runs and aren't compared.
+// The design is shut down for the readback and started again afterwards.
+bool Loader::verifyBin(string binFile, string maskFile) {
+	BitstreamSource bin(device->getPool());
+	BitstreamSource mask(device->getPool());
+	ConfigPackets packets;
+	ConfigPackets maskPackets;
+	size_t words;
+	size_t maskWords = 0;
+
+	cout << "Verifying..." << endl;
+	if (!openBitstream(binFile, bin, &packets)
+			|| !findFrames(packets, bin, &words))
+		return false;
+	if (!maskFile.empty()) {
+		if (!mask.open(maskFile)) {
+			cerr << "Failed to read mask file: " + maskFile << endl;
+			return false;
+		}
+		BitFile header;
+		if ((BitFile::hasHeader(mask) && !header.read(mask))
+				|| !maskPackets.parse(mask)
+				|| !findFrames(maskPackets, mask, &maskWords))
+			return false;
+		if (maskWords != words) {
+			cerr << "The mask file has " << maskWords
+					<< " words of frame data but the bitstream has " << words
+					<< "!" << endl;
+			return false;
+		}
+	} else {
+		cout << "No mask file, anything the design changes will mismatch" << endl;
+	}
+
+	if (!device->setFreq(tckFreq)) {
+		cerr << "Failed to set JTAG frequency!" << endl;
 		return false;
+	}
+	if (!resetState() || !setState(Jtag_fsm::RUN_TEST_IDLE))
+		return false;
+
+	// config/shutdown, the frames have to hold still while they're read
+	if (!writeConfig( { 0xFFFFFFFF, 0xAA995566, 0x20000000, 0x30008001,
+			ConfigPackets::SHUTDOWN, 0x20000000, 0x30008001, ConfigPackets::RCRC,
+			0x20000000 }))
+		return false;
+	if (!setIR(JSHUTDOWN) || !setState(Jtag_fsm::RUN_TEST_IDLE)
+			|| !device->sendClocks(12))
+		return false;
+
+	// config/readback, from FAR 0 through the frames the bitstream wrote. The
+	// readback starts with a dummy frame, one frame more than was written.
+	size_t readWords = words + ConfigPackets::frameWords;
+	vector<uint32_t> readback = { 0xFFFFFFFF, 0xAA995566, 0x20000000, 0x20000000,
+			0x30008001, ConfigPackets::RCFG, 0x20000000, 0x30002001, 0, 0x28006000,
+			(uint32_t) (0x48000000 | readWords) };
+	readback.resize(readback.size() + 32, 0x20000000);
+	if (!writeConfig(readback) || !setIR(CFG_OUT)
+			|| !device->navigateToState(Jtag_fsm::SHIFT_DR))
+		return false;
+
+	// the pad frame that ends the bitstream isn't compared
+	const size_t frameBytes = ConfigPackets::frameWords * 4;
+	const size_t end = words * 4;
+	size_t offset = 0; // bytes read back
+	uint32_t readWord = 0;
+	uint32_t expectedWord = 0;
+	uint32_t careWord = 0;
+	size_t badFrames = 0;
+	size_t lastBad = 0;
+	size_t firstBad = 0; // word of the first mismatch
+	uint32_t firstRead = 0;
+	uint32_t firstExpected = 0;
+	uint32_t firstCare = 0;
+
+	auto compare = [&](const BYTE *tdo, unsigned int count) {
+		while (count > 0) {
+			if (offset < frameBytes || offset >= end) {
+				size_t skip = offset < frameBytes ?
+						min((size_t) count, frameBytes - offset) : count;
+				offset += skip;
+				tdo += skip;
+				count -= skip;
+				continue;
+			}
+
+			const BYTE *expected;
+			const BYTE *masked = NULL;
+			size_t n = bin.next(&expected, min((size_t) count, end - offset));
+			if (n == 0 || (!maskFile.empty() && mask.next(&masked, n) != n)) {
+				cerr << "Failed to read the frame data!" << endl;
+				return false;
+			}
+			for (size_t i = 0; i < n; i++, offset++) {
+				readWord = readWord << 8 | tdo[i];
+				expectedWord = expectedWord << 8 | expected[i];
+				careWord = careWord << 8 | (masked ? ~masked[i] & 0xFF : 0xFF);
+				if (offset % 4 != 3 || ((readWord ^ expectedWord) & careWord) == 0)
+					continue;
+
+				// frame 0 of the readback is the dummy, the bitstream's first is 1
+				size_t word = offset / 4 - ConfigPackets::frameWords;
+				size_t frame = word / ConfigPackets::frameWords;
+				if (badFrames > 0 && frame == lastBad)
+					continue;
+				if (badFrames == 0) {
+					firstBad = word;
+					firstRead = readWord;
+					firstExpected = expectedWord;
+					firstCare = careWord;
+				}
+				lastBad = frame;
+				badFrames++;
+			}
+			tdo += n;
+			count -= n;
+		}
+		return true;
+	};
 
-	if (!shiftDR(32, "00000000", "0362D093", "0FFFFFFF")) // FPGA IDCODE
+	auto start = chrono::steady_clock::now();
+	bool ok = device->shiftData(readWords * 32, NULL, compare,
+			BitBuffer::MSB_FIRST)
+			&& device->navigateToState(Jtag_fsm::UPDATE_DR);
+	double seconds = chrono::duration<double>(
+			chrono::steady_clock::now() - start).count();
+
+	ok = restart() && ok;
+	if (!ok) {
+		cerr << "Failed to read back the FPGA!" << endl;
 		return false;
+	}
 
+	size_t frames = words / ConfigPackets::frameWords - 1;
+	cout << "Read back " << frames << " frames in " << seconds << " s" << endl;
+	if (badFrames > 0) {
+		cerr << badFrames << " of " << frames << " frames don't match! The first is frame "
+				<< firstBad / ConfigPackets::frameWords << " from FAR 0, word "
+				<< firstBad % ConfigPackets::frameWords << " read " << hex
+				<< setfill('0') << setw(8) << firstRead << " expected "
+				<< setw(8) << firstExpected << " mask " << setw(8)
+				<< (~firstCare) << dec << endl;
+		return false;
+	}
+	cout << "Verified." << endl;
 	return true;
 }
 
-BYTE reverse(BYTE b) {
-	b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
-	b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
-	b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
-	return b;
+// Finds the frame data of an uncompressed bitstream and moves the source to it.
+// Readback only works from FAR 0 in one pass so the frames have to be written
+// the same way, in a single FDRI packet.
+bool Loader::findFrames(const ConfigPackets &packets, BitstreamSource &source,
+		size_t *words) {
+	const ConfigPackets::Packet *fdri = NULL;
+	for (const ConfigPackets::Packet &packet : packets.getPackets()) {
+		if (packet.op != ConfigPackets::WRITE)
+			continue;
+		if (packet.reg == ConfigPackets::CBC
+				|| packet.reg == ConfigPackets::MFWR) {
+			cerr << "Only uncompressed, unencrypted bitstreams can be verified!"
+					<< endl;
+			return false;
+		}
+		if (packet.reg == ConfigPackets::FAR && packet.value != 0 && fdri == NULL) {
+			cerr << "The frame data doesn't start at FAR 0, it can't be verified!"
+					<< endl;
+			return false;
+		}
+		if (packet.reg != ConfigPackets::FDRI || packet.words == 0)
+			continue;
+		if (fdri != NULL) {
+			cerr << "The frame data is split over more than one packet, it can't be verified!"
+					<< endl;
+			return false;
+		}
+		fdri = &packet;
+	}
+
+	// the frames need a pad frame after them, with nothing to compare otherwise
+	if (fdri == NULL || fdri->words % ConfigPackets::frameWords != 0
+			|| fdri->words < 2 * ConfigPackets::frameWords) {
+		cerr << "No whole frames to verify!" << endl;
+		return false;
+	}
+	*words = fdri->words;
+	return source.seek(fdri->offset + 4);
+}
+
+// Shifts configuration packets into CFG_IN, each word most significant bit first
+bool Loader::writeConfig(const vector<uint32_t> &words) {
+	BitBuffer data(words.size() * 32);
+	for (size_t i = 0; i < words.size(); i++)
+		for (unsigned int j = 0; j < 4; j++)
+			data.data()[i * 4 + j] = words[i] >> (24 - j * 8);
+	return setIR(CFG_IN) && shiftDR(data, NULL, BitBuffer::MSB_FIRST);
 }
 
-bool Loader::setWREN() {
-	if (!setIR(USER1))
+// Starts the design again after a shutdown and lets go of the configuration logic
+bool Loader::restart() {
+	return writeConfig( { 0xFFFFFFFF, 0xAA995566, 0x20000000, 0x30008001,
+			ConfigPackets::START, 0x20000000, 0x30008001, ConfigPackets::DESYNC,
+			0x20000000, 0x20000000 }) && setIR(JSTART)
+			&& setState(Jtag_fsm::RUN_TEST_IDLE) && device->sendClocks(2000)
+			&& shiftIR(6, "09", "31", "11", "DONE check after readback")
+			&& resetState() && device->sendCommands();
+}
+
+// Reads configuration registers through CFG_OUT. The reads are queued back to
+// back and come back together, so polling several costs one round trip.
+bool Loader::readRegisters(const vector<ConfigPackets::Register> &regs,
+		vector<uint32_t> *values) {
+	vector<BitBuffer> words(regs.size());
+	if (!resetState() || !setState(Jtag_fsm::RUN_TEST_IDLE))
 		return false;
-	if (!shiftDR(8, reverseBytes("06"), "", ""))
+	for (size_t i = 0; i < regs.size(); i++)
+		if (!queueRead(regs[i], &words[i]))
+			return false;
+	if (!resetState() || !device->resolveChecks())
 		return false;
+
+	values->clear();
+	for (const BitBuffer &word : words)
+		values->push_back(registerValue(word));
 	return true;
 }
 
-int Loader::getStatus() {
-	if (!setIR(USER1))
-		return -1;
-	string data = shiftDR(17, reverseBytes("00005"));
-	cout << data << endl;
-	if (data.empty())
-		return -1;
-	int status = stoi(data, 0, 16);
-	status >>= 9;
-	return reverse(status);
+bool Loader::readRegister(ConfigPackets::Register reg, uint32_t *value) {
+	vector<uint32_t> values;
+	if (!readRegisters( { reg }, &values))
+		return false;
+	*value = values[0];
+	return true;
+}
+
+// Prints every register ConfigRegisters decodes, field by field
+bool Loader::printRegisters() {
+	vector<ConfigPackets::Register> regs = { ConfigPackets::STAT,
+			ConfigPackets::CTL0, ConfigPackets::COR0, ConfigPackets::BOOTSTS,
+			ConfigPackets::IDCODE };
+	vector<uint32_t> values;
+	if (!readRegisters(regs, &values))
+		return false;
+	for (size_t i = 0; i < regs.size(); i++)
+		cout << ConfigRegisters::describe(regs[i], values[i]) << endl;
+	string reason = ConfigRegisters::diagnose(values[0]);
+	if (!reason.empty())
+		cout << "Not configured: " << reason << endl;
+	return true;
+}
+
+// Queues a type 1 read of one register (UG470 table 6-3) and a DESYNC after it.
+// The value lands in word when the checks are resolved.
+bool Loader::queueRead(ConfigPackets::Register reg, BitBuffer *word) {
+	uint32_t read = 0x28000001 | (uint32_t) reg << 13;
+	return writeConfig( { 0xFFFFFFFF, 0xAA995566, 0x20000000, read, 0x20000000,
+			0x20000000 }) && setIR(CFG_OUT)
+			&& device->navigateToState(Jtag_fsm::SHIFT_DR)
+			&& device->deferRead(BitBuffer(32), word)
+			&& device->navigateToState(Jtag_fsm::UPDATE_DR)
+			&& writeConfig( { 0x30008001, ConfigPackets::DESYNC, 0x20000000,
+					0x20000000 });
+}
+
+// CFG_OUT shifts each word out most significant bit first
+uint32_t Loader::registerValue(const BitBuffer &word) {
+	uint32_t value = 0;
+	for (unsigned int i = 0; i < 32; i++)
+		value = value << 1 | word.getBit(i);
+	return value;
 }
 
-void hexToByte(string hex, BYTE* out) {
-	int length = hex.length();
-	for (int i = 0; i < length / 2; i++) {
-		out[i] = stoi(hex.substr(length - 2 - i * 2, 2), 0, 16);
+// Calls check until it reports done. The waits between calls start at 1 ms
+// and double up to maxPollWait, so short operations aren't held up and long
+// ones don't flood the link. Gives up after timeout ms.
+bool Loader::poll(const function<bool(bool*)> &check, unsigned int timeout,
+		const string &name) {
+	auto start = chrono::steady_clock::now();
+	unsigned int wait = 1;
+	while (true) {
+		bool done;
+		if (!check(&done))
+			return false;
+		if (done)
+			return true;
+
+		unsigned int elapsed = chrono::duration_cast<chrono::milliseconds>(
+				chrono::steady_clock::now() - start).count();
+		if (elapsed >= timeout) {
+			cerr << "Timed out waiting for " << name << "!" << endl;
+			return false;
+		}
+		if (!sleep(min(wait, timeout - elapsed)))
+			return false;
+		wait = min(wait * 2, maxPollWait);
 	}
-	if ((length & 1) != 0)
-		out[length / 2] = stoi(hex.substr(0, 1), 0, 16);
 }
 
-string Loader::reverseBytes(string start) {
-	unsigned long l = start.length();
-	if (l & 1)
-		l++;
-	l /= 2;
-	BYTE* bytes = new BYTE[l];
-	hexToByte(start, bytes);
-	for (unsigned long i = 0; i < l; i++) {
-		bytes[i] = reverse(bytes[i]);
+// The IR capture shows INIT (bit 4) and DONE (bit 5). After JPROGRAM INIT goes
+// high again once the configuration memory is clear.
+bool Loader::waitForInit() {
+	return poll([this](bool *done) {
+		uint64_t capture;
+		if (!shiftIR(6, ISC_NOOP, &capture))
+			return false;
+		*done = (capture & 0x31) == 0x11;
+		return true;
+	}, clearTimeout, "INIT after JPROGRAM");
+}
+
+// Reads the flash status register through the bridge until the write in
+// progress bit clears
+bool Loader::waitForFlash(unsigned int timeout, const string &name) {
+	return poll([this](bool *done) {
+		int status = getStatus();
+		if (status < 0)
+			return false;
+		*done = (status & 0x01) == 0;
+		return true;
+	}, timeout, name);
+}
+
+// Sends everything queued so far and then waits
+bool Loader::sleep(unsigned int ms) {
+	if (!device->sendCommands())
+		return false;
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	return true;
+}
+
+bool Loader::checkIDCODE() {
+	uint64_t idcode;
+	if (!shiftDR(IDCODE, 32, 0, &idcode))
+		return false;
+
+	if ((idcode & 0x0FFFFFFF) != 0x0362D093) { // FPGA IDCODE, ignoring the revision
+		cerr << "IDCODE check failed! Got " << hex << setw(8) << setfill('0')
+				<< idcode << " expected 0362d093" << dec << endl;
+		return false;
 	}
-	std::stringstream ss;
-	for (long i = l - 1; i >= 0; i--)
-		ss << setfill('0') << setw(2) << hex << (unsigned int) bytes[i];
-	string out = ss.str();
-	if (out.length() - 1 == start.length())
-		out = out.substr(1, out.length() - 1);
-	delete bytes;
-	return out;
+
+	return true;
 }
 
+bool Loader::setWREN() {
+	return shiftDR(USER1, 8, BitBuffer::reverse(0x06), NULL);
+}
+
+int Loader::getStatus() {
+	uint64_t data;
+	if (!shiftDR(USER1, 17, BitBuffer::reverse(0x05), &data))
+		return -1;
+	int status = data >> 9;
+	return BitBuffer::reverse(status);
+}
@@ -15,12 +15,17 @@
 #include <iostream>
 #include <iomanip>
 #include<algorithm>
+#include <vector>
+#include <functional>
 #include "jtag.h"
 #include "jtag_fsm.h"
+#include "bit_buffer.h"
+#include "bitstream_source.h"
+#include "config_packets.h"
 
 class Loader {
 	Jtag* device;
-	Jtag_fsm::State currentState;
+	double tckFreq; // TCK for configuration, the bridge runs at this or slower
 
 	public:
 	enum Instruction {
@@ -55,21 +60,51 @@ public:
 	Loader(Jtag*);
 	bool resetState();
 	bool checkIDCODE();
+	void setFreq(double);
+	double getFreq();
+	double calibrateFreq();
 	bool eraseFlash(string);
 	bool writeBin(string, bool, string);
+	bool verifyBin(string, string);
+	bool readRegisters(const vector<ConfigPackets::Register>&, vector<uint32_t>*);
+	bool readRegister(ConfigPackets::Register, uint32_t*);
+	bool printRegisters();
 
 private:
 	bool setWREN();
 	bool setIR(Instruction);
 	bool shiftUDR(int, string, string, string);
-	bool shiftDR(int, string, string, string);
+	bool shiftDR(const BitBuffer&, BitBuffer*, BitBuffer::BitOrder =
+			BitBuffer::LSB_FIRST);
+	bool shiftDR(const BitBuffer&, const BitBuffer&, const BitBuffer&,
+			string = "");
+	bool shiftDR(BitstreamSource&, BitBuffer::BitOrder =
+			BitBuffer::LSB_FIRST);
+	bool shiftDR(int, string, string, string, string = "");
+	bool shiftDR(int, uint64_t, uint64_t*);
+	bool shiftDR(Instruction, int, uint64_t, uint64_t*);
 	string shiftDR(int, string);
-	bool shiftIR(int, string, string, string);
+	bool shiftIR(const BitBuffer&, const BitBuffer&, const BitBuffer&,
+			string = "");
+	bool shiftIR(int, string, string, string, string = "");
+	bool shiftIR(int, uint64_t, uint64_t*);
 	int getStatus();
-	string reverseBytes(string);
-	string fileToBinStr(string);
+	bool checkFreq(uint64_t);
+	bool openBitstream(string, BitstreamSource&, ConfigPackets*);
+	bool checkPart(string, uint32_t);
+	void showProgress(BitstreamSource&, const ConfigPackets&);
 	bool loadBin(string);
+	bool configure(BitstreamSource&, BitBuffer*);
+	bool findFrames(const ConfigPackets&, BitstreamSource&, size_t*);
+	bool writeConfig(const vector<uint32_t>&);
+	bool restart();
+	bool queueRead(ConfigPackets::Register, BitBuffer*);
+	static uint32_t registerValue(const BitBuffer&);
 	bool setState(Jtag_fsm::State);
+	bool poll(const function<bool(bool*)>&, unsigned int, const string&);
+	bool waitForInit();
+	bool waitForFlash(unsigned int, const string&);
+	bool sleep(unsigned int);
 };
 
 
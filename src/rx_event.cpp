@@ -0,0 +1,135 @@
+/*
+ * rx_event.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "rx_event.h"
+#include <iostream>
+#include <chrono>
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+using namespace std;
+using get_time = chrono::steady_clock;
+
+// Upper bound on a single sleep in case the driver misses a notification
+static const unsigned int maxSleep = 10;
+
+RxEvent::RxEvent() {
+	ftHandle = 0;
+	armed = false;
+#ifdef _WIN32
+	event = NULL;
+#else
+	pthread_mutex_init(&event.eMutex, NULL);
+	pthread_cond_init(&event.eCondVar, NULL);
+	event.iVar = 0;
+#endif
+}
+
+RxEvent::~RxEvent() {
+	stop();
+#ifndef _WIN32
+	pthread_cond_destroy(&event.eCondVar);
+	pthread_mutex_destroy(&event.eMutex);
+#endif
+}
+
+bool RxEvent::start(FT_HANDLE handle) {
+	stop();
+	ftHandle = handle;
+#ifdef _WIN32
+	event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (event == NULL)
+		return false;
+	armed = FT_SetEventNotification(ftHandle, FT_EVENT_RXCHAR, event) == FT_OK;
+#else
+	armed = FT_SetEventNotification(ftHandle, FT_EVENT_RXCHAR, &event)
+			== FT_OK;
+#endif
+	return armed;
+}
+
+void RxEvent::stop() {
+	if (armed)
+		FT_SetEventNotification(ftHandle, 0, NULL);
+	armed = false;
+#ifdef _WIN32
+	if (event != NULL)
+		CloseHandle(event);
+	event = NULL;
+#endif
+}
+
+// Waits up to timeout ms for at least count bytes to be waiting in the receive queue
+bool RxEvent::wait(DWORD count, unsigned int timeout) {
+	get_time::time_point deadline = get_time::now()
+			+ chrono::milliseconds(timeout);
+
+	while (true) {
+		DWORD dwNumBytesToRead = 0;
+#ifndef _WIN32
+		// held from the check through the wait so a notification can't land in between
+		pthread_mutex_lock(&event.eMutex);
+#endif
+		FT_STATUS ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
+		get_time::time_point now = get_time::now();
+		bool waiting = ftStatus == FT_OK && dwNumBytesToRead < count
+				&& now < deadline;
+		if (waiting) {
+			unsigned int left = chrono::duration_cast<chrono::milliseconds>(
+					deadline - now).count() + 1;
+			sleep(left < maxSleep ? left : maxSleep);
+		}
+#ifndef _WIN32
+		pthread_mutex_unlock(&event.eMutex);
+#endif
+
+		if (ftStatus != FT_OK)
+			return false;
+		if (dwNumBytesToRead >= count)
+			return true;
+		if (!waiting) {
+			cerr << "Timed out waiting for " << count << " bytes (got "
+					<< dwNumBytesToRead << ")!" << endl;
+			return false;
+		}
+	}
+}
+
+// Waits for count bytes and reads them
+bool RxEvent::read(BYTE *data, DWORD count, unsigned int timeout) {
+	DWORD dwNumBytesRead = 0;
+
+	if (!wait(count, timeout))
+		return false;
+
+	FT_STATUS ftStatus = FT_Read(ftHandle, data, count, &dwNumBytesRead);
+	return ftStatus == FT_OK && dwNumBytesRead == count;
+}
+
+// Sleeps until the driver signals new data or ms pass. Without notifications
+// nothing signals so the wait runs out.
+void RxEvent::sleep(unsigned int ms) {
+#ifdef _WIN32
+	if (armed)
+		WaitForSingleObject(event, ms);
+	else
+		Sleep(ms);
+#else
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec += ms / 1000;
+	until.tv_nsec += (ms % 1000) * 1000000L;
+	if (until.tv_nsec >= 1000000000L) {
+		until.tv_sec++;
+		until.tv_nsec -= 1000000000L;
+	}
+
+	// the caller holds the mutex, any wake up sends it back to check the queue
+	// so spurious ones are harmless
+	pthread_cond_timedwait(&event.eCondVar, &event.eMutex, &until);
+#endif
+}
@@ -0,0 +1,40 @@
+/*
+ * rx_event.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef RX_EVENT_H_
+#define RX_EVENT_H_
+
+#include "ftd2xx.h"
+
+/*
+ * Waits for the FTDI to receive data using FT_SetEventNotification instead of
+ * polling FT_GetQueueStatus. The driver signals the event whenever bytes
+ * arrive so the waiting thread sleeps while the device is busy.
+ */
+class RxEvent {
+	FT_HANDLE ftHandle;
+	bool armed;
+#ifdef _WIN32
+	HANDLE event;
+#else
+	EVENT_HANDLE event;
+#endif
+
+public:
+	RxEvent();
+	~RxEvent();
+	bool start(FT_HANDLE);
+	void stop();
+	bool wait(DWORD, unsigned int);
+	bool read(BYTE*, DWORD, unsigned int);
+
+private:
+	RxEvent(const RxEvent&);
+	RxEvent& operator=(const RxEvent&);
+	void sleep(unsigned int);
+};
+
+#endif /* RX_EVENT_H_ */
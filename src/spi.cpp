@@ -163,6 +163,8 @@ Spi::Spi() {
 	ftHandle = 0;
 	active = false;
 	verbose = false;
+	transferSize = 65536;
+	readTimeout = 5000;
 }
 
 FT_STATUS Spi::connect(unsigned int devNumber) {
@@ -170,6 +172,10 @@ FT_STATUS Spi::connect(unsigned int devNumber) {
 }
 
 FT_STATUS Spi::disconnect() {
+	if (active && !(writer.submit() && writer.wait()))
+		cerr << "Failed to send queued commands!" << endl;
+	writer.stop();
+	rxEvent.stop();
 	active = false;
 	return FT_Close(ftHandle);
 }
@@ -199,6 +205,9 @@ bool Spi::initialize() {
 
 	std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Wait for all the USB stuff to complete and work
 
+	if (!rxEvent.start(ftHandle))
+		cerr << "Failed to set event notification, reads will poll." << endl;
+
 	if (!sync_mpsse()){
 		cerr << "Failed to sync with MPSSE!" << endl;
 		return false;
@@ -209,6 +218,16 @@ bool Spi::initialize() {
 		return false;
 	}
 
+	// reads here don't send 0x87, they wait on the latency timer so it stays at 1 ms
+	UsbTuner::Profile profile; // falls back to the settings above
+	profile.latency = 1;
+	if (!UsbTuner(ftHandle, rxEvent).select(&profile, 1))
+		cerr << "Failed to tune USB transfers, using the defaults." << endl;
+	transferSize = profile.transferSize;
+
+	// a batch is submitted once it reaches transferSize, one 64KB command past it at most
+	writer.reserve(transferSize + 3 + 65536);
+	writer.start(ftHandle);
 	active = true;
 
 	return true;
@@ -230,15 +249,14 @@ bool Spi::sync_mpsse() {
 			&dwNumBytesSent);
 	// Send off the BAD commands
 	dwNumBytesToSend = 0; // Reset output buffer pointer
-	do {
-		ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
-		// Get the number of bytes in the device input buffer
-	} while ((dwNumBytesToRead == 0) && (ftStatus == FT_OK));
-	if (dwNumBytesRead > 8) {
-		cerr << "Input buffer too small in sync_mpsse()!" << endl;
+	// Wait for the two byte echo
+	if (!rxEvent.wait(2, readTimeout))
 		return false;
-	}
-	//or Timeout
+	ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesToRead);
+	if (ftStatus != FT_OK)
+		return false;
+	if (dwNumBytesToRead > 8)
+		dwNumBytesToRead = 8; // anything past the echo is flushed later
 	bool bCommandEchod = false;
 	ftStatus = FT_Read(ftHandle, &byInputBuffer, dwNumBytesToRead,
 			&dwNumBytesRead);
@@ -365,10 +383,13 @@ void Spi::check_rx() {
 	DWORD dwNumBytesRead = 0;
 
 	while (1) {
+		ftStatus = FT_GetQueueStatus(ftHandle, &dwNumBytesRead);
+		if (ftStatus != FT_OK || dwNumBytesRead == 0)
+			break;
 		ftStatus = FT_Read(ftHandle, &byInputBuffer, 1, &dwNumBytesRead);
-		if (ftStatus != FT_OK)
+		if (ftStatus != FT_OK || dwNumBytesRead == 0)
 			break;
-		cerr << "Unexpected rx byte: " << byInputBuffer[0] << endl;
+		cerr << "Unexpected rx byte: " << (int) byInputBuffer[0] << endl;
 	}
 }
 
@@ -381,42 +402,30 @@ void Spi::error(int status) {
 }
 
 BYTE Spi::recv_byte() {
-	FT_STATUS ftStatus;
 	BYTE byInputBuffer[1];
-	DWORD dwNumBytesRead = 0;
-	while (1) {
-		ftStatus = FT_Read(ftHandle, &byInputBuffer, 1, &dwNumBytesRead);
-		if (ftStatus != FT_OK) {
-			cerr << "Read error." << endl;
-			error(2);
-		}
-		if (dwNumBytesRead == 1)
-			break;
-		std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+	send_commands();
+
+	if (!rxEvent.read(byInputBuffer, 1, readTimeout)) {
+		cerr << "Read error." << endl;
+		error(2);
 	}
 	return byInputBuffer[0];
 }
 
 void Spi::send_byte(uint8_t data) {
-	FT_STATUS ftStatus;
-	BYTE byOutputBuffer[1];
-	DWORD dwNumBytesSent = 0;
-
-	byOutputBuffer[0] = data;
+	writer.buffer().push_back(data);
+}
 
-	ftStatus = FT_Write(ftHandle, byOutputBuffer, 1, &dwNumBytesSent);
-	if (ftStatus != FT_OK) {
+// Writes out everything queued by send_byte() and send_spi()
+void Spi::send_commands() {
+	if (!writer.submit() || !writer.wait()) {
 		cerr << "Write error!" << endl;
 		error(2);
 	}
-	if (dwNumBytesSent != 1) {
-		cerr << "Write error (single byte, received " << dwNumBytesSent
-				<< ", expected 1)." << endl;
-		error(2);
-	}
 }
 
-void Spi::send_spi(uint8_t *data, int n) {
+void Spi::send_spi(const uint8_t *data, int n) {
 	if (n < 1)
 		return;
 
@@ -425,20 +434,12 @@ void Spi::send_spi(uint8_t *data, int n) {
 	send_byte(n - 1);
 	send_byte((n - 1) >> 8);
 
-	FT_STATUS ftStatus;
-	DWORD dwNumBytesSent = 0;
-
-	ftStatus = FT_Write(ftHandle, data, n, &dwNumBytesSent);
-	if (ftStatus != FT_OK) {
+	vector<BYTE> &commands = writer.buffer();
+	commands.insert(commands.end(), data, data + n);
+	if (commands.size() >= transferSize && !writer.submit()) {
 		cerr << "Write error!" << endl;
 		error(2);
 	}
-
-	if (dwNumBytesSent != (unsigned int) n) {
-		fprintf(stderr, "Write error (chunk, rc=%u, expected %d).\n",
-				dwNumBytesSent, n);
-		error(2);
-	}
 }
 
 void Spi::xfer_spi(uint8_t *data, int n) {
@@ -450,20 +451,8 @@ void Spi::xfer_spi(uint8_t *data, int n) {
 	send_byte(n - 1);
 	send_byte((n - 1) >> 8);
 
-	FT_STATUS ftStatus;
-	DWORD dwNumBytesSent = 0;
-
-	ftStatus = FT_Write(ftHandle, data, n, &dwNumBytesSent);
-	if (ftStatus != FT_OK) {
-		cerr << "Write error!" << endl;
-		error(2);
-	}
-
-	if (dwNumBytesSent != (unsigned int) n) {
-		fprintf(stderr, "Write error (chunk, rc=%u, expected %d).\n",
-				dwNumBytesSent, n);
-		error(2);
-	}
+	vector<BYTE> &commands = writer.buffer();
+	commands.insert(commands.end(), data, data + n);
 
 	for (int i = 0; i < n; i++)
 		data[i] = recv_byte();
@@ -693,7 +682,7 @@ void Spi::flash_64kB_sector_erase(int addr) {
 	flash_chip_deselect();
 }
 
-void Spi::flash_prog(int addr, uint8_t *data, int n) {
+void Spi::flash_prog(int addr, const uint8_t *data, int n) {
 	if (verbose)
 		fprintf(stdout, "prog 0x%06X +0x%03X..\n", addr, n);
 
@@ -801,6 +790,7 @@ bool Spi::eraseFlash() {
 	fprintf(stdout, "reset..\n");
 
 	flash_chip_deselect();
+	send_commands();
 	std::this_thread::sleep_for(std::chrono::milliseconds(250));
 
 	fprintf(stdout, "cdone: %s\n", get_cdone() ? "high" : "low");
@@ -821,67 +811,33 @@ bool Spi::eraseFlash() {
 	flash_power_down();
 
 	set_gpio(1, 1);
+	send_commands();
 	std::this_thread::sleep_for(std::chrono::milliseconds(250));
 
 	fprintf(stdout, "cdone: %s\n", get_cdone() ? "high" : "low");
 
 	return true;
 }
+unsigned long Spi::getAllocations() {
+	return pool.getAllocations();
+}
+
 bool Spi::writeBin(string filename) {
 	int rw_offset = 0;
 
-	FILE *f = NULL;
-	long file_size = -1;
-
-	f = fopen(filename.c_str(), "rb");
+	BitstreamSource source(pool);
 
-	if (f == NULL) {
-		fprintf(stderr, "Can't open '%s' for reading: ", filename.c_str());
+	if (!source.open(filename)) {
+		fprintf(stderr, "Can't open '%s' for reading\n", filename.c_str());
 		return false;
 	}
 
-	if (fseek(f, 0L, SEEK_END) != -1) {
-		file_size = ftell(f);
-		if (file_size == -1) {
-			fprintf(stderr, "%s: ftell: ", filename.c_str());
-			return false;
-		}
-		if (fseek(f, 0L, SEEK_SET) == -1) {
-			fprintf(stderr, "%s: fseek: ", filename.c_str());
-			return false;
-		}
-	} else {
-		FILE *pipe = f;
-
-		f = tmpfile();
-		if (f == NULL) {
-			fprintf(stderr, "can't open temporary file\n");
-			return false;
-		}
-		file_size = 0;
-
-		while (true) {
-			static unsigned char buffer[4096];
-			size_t rc = fread(buffer, 1, 4096, pipe);
-			if (rc <= 0)
-				break;
-			size_t wc = fwrite(buffer, 1, rc, f);
-			if (wc != rc) {
-				fprintf(stderr, "can't write to temporary file\n");
-				return false;
-			}
-			file_size += rc;
-		}
-		fclose(pipe);
-
-		/* now seek to the beginning so we can
-		 start reading again */
-		fseek(f, 0, SEEK_SET);
-	}
+	long file_size = source.size();
 
 	cout << "Resetting..." << endl;
 
 	flash_chip_deselect();
+	send_commands();
 	std::this_thread::sleep_for(std::chrono::milliseconds(250));
 
 	cout << "cdone: " << (get_cdone() ? "high" : "low") << endl;
@@ -907,20 +863,22 @@ bool Spi::writeBin(string filename) {
 	cout << "Programming... ";
 
 	for (int rc, addr = 0; true; addr += rc) {
-		uint8_t buffer[256];
+		const uint8_t *page;
 		int page_size = 256 - (rw_offset + addr) % 256;
-		rc = fread(buffer, 1, page_size, f);
+		rc = source.next(&page, page_size);
 		if (rc <= 0)
 			break;
 		flash_write_enable();
-		flash_prog(rw_offset + addr, buffer, rc);
+		flash_prog(rw_offset + addr, page, rc);
 		flash_wait();
 	}
 
-	cout << "Done." << endl;
+	if (source.remaining() > 0) {
+		fprintf(stderr, "Failed to read '%s'\n", filename.c_str());
+		return false;
+	}
 
-	/* seek to the beginning for second pass */
-	fseek(f, 0, SEEK_SET);
+	cout << "Done." << endl;
 
 	// ---------------------------------------------------------
 	// Reset
@@ -929,12 +887,11 @@ bool Spi::writeBin(string filename) {
 	flash_power_down();
 
 	set_gpio(1, 1);
+	send_commands();
 	std::this_thread::sleep_for(std::chrono::milliseconds(250));
 
 	cout << "cdone: " << (get_cdone() ? "high" : "low") << endl;
 	cout << "Done." << endl;
 
-	if (f != NULL && f != stdin && f != stdout)
-		fclose(f);
 	return true;
 }
@@ -9,6 +9,11 @@
 #define SPI_H_
 
 #include "ftd2xx.h"
+#include "bitstream_source.h"
+#include "buffer_pool.h"
+#include "usb_writer.h"
+#include "rx_event.h"
+#include "usb_tuner.h"
 #include <unistd.h>
 #include <string>
 #include <stdint.h>
@@ -20,6 +25,11 @@ class Spi {
 	unsigned int uiDevIndex = 0xF; // The device in the list that is used
 	bool active;
 	bool verbose;
+	UsbWriter writer; // Queues MPSSE commands and writes them on its own thread
+	unsigned int transferSize; // Queued commands are sent once they reach this size
+	RxEvent rxEvent; // Sleeps until read data arrives
+	unsigned int readTimeout; // ms to wait for read data
+	BufferPool pool; // Scratch buffers, lends writeBin() the slices of files that can't be mapped
 
 public:
 	Spi();
@@ -28,18 +38,19 @@ public:
 	bool initialize();
 	bool eraseFlash();
 	bool writeBin(string);
+	unsigned long getAllocations();
 
 private:
 	bool sync_mpsse();
 	bool config_spi();
 	static void hexToByte(string, BYTE*);
 	bool flush();
-	bool compareHexString(string, string, string);
 	void check_rx();
 	void error(int);
 	BYTE recv_byte();
 	void send_byte(BYTE data);
-	void send_spi(uint8_t *data, int n);
+	void send_commands();
+	void send_spi(const uint8_t *data, int n);
 	void xfer_spi(uint8_t *data, int n);
 	uint8_t xfer_spi_bits(uint8_t data, int n);
 	void set_gpio(int slavesel_b, int creset_b);
@@ -57,7 +68,7 @@ private:
 	void flash_write_enable();
 	void flash_bulk_erase();
 	void flash_64kB_sector_erase(int addr);
-	void flash_prog(int addr, uint8_t *data, int n);
+	void flash_prog(int addr, const uint8_t *data, int n);
 	void flash_read(int addr, uint8_t *data, int n);
 	void flash_wait();
 	void flash_disable_protection();
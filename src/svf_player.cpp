@@ -0,0 +1,365 @@
+/*
+ * svf_player.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "svf_player.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+SvfPlayer::SvfPlayer(Jtag *dev) {
+	jtag = dev;
+	hir.length = hdr.length = sir.length = sdr.length = tir.length =
+			tdr.length = 0;
+	endIr = endDr = runState = runEnd = Jtag_fsm::RUN_TEST_IDLE;
+	maxFreq = 0;
+	line = 0;
+}
+
+bool SvfPlayer::play(string file) {
+	ifstream in(file);
+	if (!in.is_open()) {
+		cerr << "Failed to open file " << file << endl;
+		return false;
+	}
+	return play(in);
+}
+
+// Runs every statement in the stream, stopping at the first error or failed check
+bool SvfPlayer::play(istream &in) {
+	string text;
+	string statement;
+	unsigned int lineNumber = 0;
+	bool started = false;
+	bool ok = true;
+
+	maxFreq = jtag->getFreq();
+	jtag->setDeferChecks(true);
+
+	while (ok && getline(in, text)) {
+		lineNumber++;
+
+		// comments run to the end of the line
+		size_t end = min(text.find("//"), text.find('!'));
+		if (end != string::npos)
+			text.erase(end);
+
+		// statements end with a semicolon and can span any number of lines
+		size_t start = 0;
+		while (ok) {
+			size_t semicolon = text.find(';', start);
+			size_t stop = semicolon == string::npos ? text.size() : semicolon;
+			if (!started && text.find_first_not_of(" \t\r", start) < stop) {
+				started = true;
+				line = lineNumber;
+			}
+			if (started)
+				statement.append(text, start, stop - start);
+			if (semicolon == string::npos)
+				break;
+			ok = !started || execute(statement);
+			statement.clear();
+			started = false;
+			start = semicolon + 1;
+		}
+		if (started)
+			statement += ' ';
+	}
+
+	if (ok && started)
+		ok = error("Missing ; at the end of the file");
+
+	ok = ok && jtag->resolveChecks() && jtag->sendCommands();
+	jtag->setDeferChecks(false);
+	jtag->setFreq(maxFreq);
+	return ok;
+}
+
+bool SvfPlayer::execute(const string &statement) {
+	vector<string> tokens;
+	if (!tokenize(statement, &tokens))
+		return error("Unbalanced parentheses");
+
+	const string &command = tokens[0];
+	if (command == "SIR")
+		return parsePattern(tokens, &sir)
+				&& scan(hir, sir, tir, Jtag_fsm::SHIFT_IR, endIr);
+	if (command == "SDR")
+		return parsePattern(tokens, &sdr)
+				&& scan(hdr, sdr, tdr, Jtag_fsm::SHIFT_DR, endDr);
+	if (command == "HIR")
+		return parsePattern(tokens, &hir);
+	if (command == "HDR")
+		return parsePattern(tokens, &hdr);
+	if (command == "TIR")
+		return parsePattern(tokens, &tir);
+	if (command == "TDR")
+		return parsePattern(tokens, &tdr);
+	if (command == "RUNTEST")
+		return runTest(tokens);
+	if (command == "STATE")
+		return moveState(tokens);
+	if (command == "FREQUENCY")
+		return setFrequency(tokens);
+	if (command == "ENDIR" || command == "ENDDR") {
+		Jtag_fsm::State state;
+		if (tokens.size() != 2)
+			return error("Expected a state after " + command);
+		if (!parseState(tokens[1], &state))
+			return false;
+		if (!isStable(state))
+			return error(tokens[1] + " isn't a stable state");
+		(command == "ENDIR" ? endIr : endDr) = state;
+		return true;
+	}
+	if (command == "TRST")
+		return true; // the boards don't have a TRST pin
+
+	return error("Unsupported command " + command);
+}
+
+// Splits a statement into upper case words with each parenthesized value as one
+// word, whitespace and all removed. Returns false if the parentheses don't match.
+bool SvfPlayer::tokenize(const string &statement, vector<string> *tokens) {
+	string token;
+	bool group = false;
+
+	tokens->clear();
+	for (char c : statement) {
+		if (group) {
+			if (c == ')') {
+				tokens->push_back(token);
+				token.clear();
+				group = false;
+			} else if (c == '(') {
+				return false;
+			} else if (!isspace((unsigned char) c)) {
+				token += toupper((unsigned char) c);
+			}
+		} else if (c == '(' || isspace((unsigned char) c)) {
+			if (!token.empty())
+				tokens->push_back(token);
+			token.clear();
+			group = c == '(';
+		} else if (c == ')') {
+			return false;
+		} else {
+			token += toupper((unsigned char) c);
+		}
+	}
+	if (!token.empty())
+		tokens->push_back(token);
+	return !group && !tokens->empty();
+}
+
+// Reads "length [TDI (x)] [TDO (x)] [MASK (x)] [SMASK (x)]" into pattern
+bool SvfPlayer::parsePattern(const vector<string> &tokens, Pattern *pattern) {
+	double value;
+	if (tokens.size() < 2 || !parseNumber(tokens[1], &value) || value < 0
+			|| value != floor(value))
+		return error("Expected a length after " + tokens[0]);
+
+	unsigned int length = value;
+	bool tdi = false;
+
+	// TDI and MASK only carry over while the length stays the same
+	if (length != pattern->length) {
+		pattern->length = length;
+		pattern->tdi = BitBuffer();
+		pattern->mask = BitBuffer();
+	}
+	pattern->tdo = BitBuffer();
+
+	for (size_t i = 2; i < tokens.size(); i += 2) {
+		const string &key = tokens[i];
+		if (i + 1 >= tokens.size())
+			return error("Missing value for " + key);
+
+		BitBuffer bits = BitBuffer::fromHex(tokens[i + 1], length);
+		if (bits.size() != length)
+			return error("Invalid value for " + key);
+
+		if (key == "TDI") {
+			pattern->tdi = move(bits);
+			tdi = true;
+		} else if (key == "TDO") {
+			pattern->tdo = move(bits);
+		} else if (key == "MASK") {
+			pattern->mask = move(bits);
+		} else if (key != "SMASK") { // TDI is always driven so there's nothing to mask
+			return error("Unknown parameter " + key);
+		}
+	}
+
+	if (!tdi && length > 0 && pattern->tdi.size() != length)
+		return error("Missing TDI for " + tokens[0]);
+	return true;
+}
+
+// Shifts header, body and trailer as one scan and leaves it in endState
+bool SvfPlayer::scan(const Pattern &header, const Pattern &body,
+		const Pattern &trailer, Jtag_fsm::State shiftState,
+		Jtag_fsm::State endState) {
+	unsigned int total = header.length + body.length + trailer.length;
+	bool checked = !header.tdo.empty() || !body.tdo.empty()
+			|| !trailer.tdo.empty();
+	bool ok;
+
+	if (total == 0)
+		return jtag->navigateToState(endState);
+	if (!jtag->navigateToState(shiftState))
+		return false;
+
+	if (header.length == 0 && trailer.length == 0) {
+		// the common case, the body is shifted as is without copying it
+		ok = checked ?
+				jtag->shiftData(body.tdi, body.tdo, body.mask, checkName()) :
+				jtag->shiftData(body.tdi, NULL);
+	} else {
+		// the header is shifted first so it ends up in the devices closest to TDO
+		BitBuffer tdi = header.tdi;
+		tdi.append(body.tdi);
+		tdi.append(trailer.tdi);
+
+		if (checked) {
+			BitBuffer tdo;
+			BitBuffer mask;
+			for (const Pattern *part : { &header, &body, &trailer }) {
+				bool partChecked = !part->tdo.empty();
+				tdo.append(partChecked ? part->tdo : BitBuffer(part->length));
+				mask.append(!partChecked ? BitBuffer(part->length) :
+						part->mask.empty() ? BitBuffer::ones(part->length) : part->mask);
+			}
+			ok = jtag->shiftData(tdi, tdo, mask, checkName());
+		} else {
+			ok = jtag->shiftData(tdi, NULL);
+		}
+	}
+
+	return ok && jtag->navigateToState(endState);
+}
+
+// RUNTEST [run_state] [count TCK|SCK] [time SEC [MAXIMUM time SEC]] [ENDSTATE end_state]
+bool SvfPlayer::runTest(const vector<string> &tokens) {
+	double count = 0;
+	double minTime = 0;
+	double value;
+	size_t i = 1;
+
+	// the run state also becomes the end state unless one is given
+	if (i < tokens.size() && isalpha((unsigned char) tokens[i][0])
+			&& tokens[i] != "MAXIMUM" && tokens[i] != "ENDSTATE") {
+		if (!parseState(tokens[i], &runState))
+			return false;
+		runEnd = runState;
+		i++;
+	}
+
+	while (i < tokens.size()) {
+		if (tokens[i] == "ENDSTATE") {
+			if (i + 1 >= tokens.size())
+				return error("Expected a state after ENDSTATE");
+			if (!parseState(tokens[i + 1], &runEnd))
+				return false;
+			i += 2;
+		} else if (tokens[i] == "MAXIMUM") {
+			// TCK is counted exactly so the run never goes over the maximum
+			if (i + 2 >= tokens.size() || !parseNumber(tokens[i + 1], &value)
+					|| tokens[i + 2] != "SEC")
+				return error("Expected a time after MAXIMUM");
+			i += 3;
+		} else {
+			if (i + 1 >= tokens.size() || !parseNumber(tokens[i], &value)
+					|| value < 0)
+				return error("Invalid RUNTEST parameter " + tokens[i]);
+			// there's no separate system clock, SCK cycles are run on TCK
+			if (tokens[i + 1] == "TCK" || tokens[i + 1] == "SCK")
+				count = value;
+			else if (tokens[i + 1] == "SEC")
+				minTime = value;
+			else
+				return error("Unknown RUNTEST unit " + tokens[i + 1]);
+			i += 2;
+		}
+	}
+
+	if (!isStable(runState) || !isStable(runEnd))
+		return error("RUNTEST states must be stable");
+
+	// the minimum time is spent clocking TCK so it's queued with everything else instead of sleeping
+	double cycles = max(ceil(count), ceil(minTime * jtag->getFreq()));
+	return jtag->navigateToState(runState)
+			&& jtag->sendClocks((unsigned long) cycles)
+			&& jtag->navigateToState(runEnd);
+}
+
+// STATE [path states] stable_state, RESET is always reached with five TMS high clocks
+bool SvfPlayer::moveState(const vector<string> &tokens) {
+	vector<Jtag_fsm::State> path(tokens.size() - 1);
+
+	if (path.empty())
+		return error("Expected a state after STATE");
+	for (size_t i = 0; i < path.size(); i++)
+		if (!parseState(tokens[i + 1], &path[i]))
+			return false;
+	if (!isStable(path.back()))
+		return error(tokens.back() + " isn't a stable state");
+
+	for (Jtag_fsm::State state : path) {
+		bool ok = state == Jtag_fsm::TEST_LOGIC_RESET ?
+				jtag->resetState() : jtag->navigateToState(state);
+		if (!ok)
+			return false;
+	}
+	return true;
+}
+
+// FREQUENCY [cycles HZ] caps TCK, without a value the starting rate is restored
+bool SvfPlayer::setFrequency(const vector<string> &tokens) {
+	double freq;
+
+	if (tokens.size() == 1)
+		return jtag->setFreq(maxFreq);
+	if (tokens.size() != 3 || tokens[2] != "HZ"
+			|| !parseNumber(tokens[1], &freq) || freq <= 0)
+		return error("Expected a frequency in HZ");
+
+	// never run faster than the board was set up for
+	return jtag->setFreq(min(freq, maxFreq));
+}
+
+bool SvfPlayer::parseState(const string &name, Jtag_fsm::State *state) {
+	*state = Jtag_fsm::getStateFromName(name);
+	if (*state == Jtag_fsm::TEST_LOGIC_RESET && name != "RESET")
+		return error("Invalid state " + name);
+	return true;
+}
+
+bool SvfPlayer::parseNumber(const string &token, double *value) {
+	char *end;
+	*value = strtod(token.c_str(), &end);
+	return !token.empty() && *end == '\0';
+}
+
+bool SvfPlayer::isStable(Jtag_fsm::State state) {
+	return state == Jtag_fsm::TEST_LOGIC_RESET
+			|| state == Jtag_fsm::RUN_TEST_IDLE || state == Jtag_fsm::PAUSE_DR
+			|| state == Jtag_fsm::PAUSE_IR;
+}
+
+// Failed checks are reported with the line their scan came from
+string SvfPlayer::checkName() {
+	return "Line " + to_string(line);
+}
+
+bool SvfPlayer::error(const string &message) {
+	cerr << "SVF error on line " << line << ": " << message << endl;
+	return false;
+}
@@ -0,0 +1,67 @@
+/*
+ * svf_player.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef SVF_PLAYER_H_
+#define SVF_PLAYER_H_
+
+#include "jtag.h"
+#include "jtag_fsm.h"
+#include "bit_buffer.h"
+#include <istream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Plays Serial Vector Format files. The file is read a statement at a time and
+ * every statement is queued on Jtag without waiting for the one before, TDO
+ * checks included, so a long file runs at the speed of the USB link. Checks are
+ * deferred so Jtag reads them back in batches, a failed one is reported with
+ * the line it came from.
+ */
+class SvfPlayer {
+	// A scan's data as the file gives it. TDI and MASK carry over to the next scan
+	// of the same length, TDO is only checked on the scan that specifies it.
+	class Pattern {
+	public:
+		unsigned int length;
+		BitBuffer tdi;
+		BitBuffer tdo; // empty when TDO isn't checked
+		BitBuffer mask; // empty to check every bit
+	};
+
+	Jtag *jtag;
+	Pattern hir, hdr, sir, sdr, tir, tdr;
+	Jtag_fsm::State endIr;
+	Jtag_fsm::State endDr;
+	Jtag_fsm::State runState;
+	Jtag_fsm::State runEnd;
+	double maxFreq; // TCK rate when play() started, FREQUENCY only slows down from it
+	unsigned int line; // line the current statement started on
+
+public:
+	SvfPlayer(Jtag*);
+	bool play(string);
+	bool play(istream&);
+
+private:
+	bool execute(const string&);
+	bool parsePattern(const vector<string>&, Pattern*);
+	bool scan(const Pattern&, const Pattern&, const Pattern&,
+			Jtag_fsm::State, Jtag_fsm::State);
+	bool runTest(const vector<string>&);
+	bool moveState(const vector<string>&);
+	bool setFrequency(const vector<string>&);
+	bool parseState(const string&, Jtag_fsm::State*);
+	string checkName();
+	bool error(const string&);
+	static bool tokenize(const string&, vector<string>*);
+	static bool parseNumber(const string&, double*);
+	static bool isStable(Jtag_fsm::State);
+};
+
+#endif /* SVF_PLAYER_H_ */
@@ -0,0 +1,219 @@
+/*
+ * usb_tuner.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "usb_tuner.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+using get_time = chrono::steady_clock;
+
+// Settings tried while tuning
+static const UCHAR latencies[] = { 1, 2, 4, 8, 16 };
+static const DWORD transferSizes[] = { 4096, 16384, 65536 };
+// GPIO reads in the bulk throughput test
+static const unsigned int bulkBytes = 16384;
+// Single byte reads averaged for the round trip time
+static const unsigned int roundTrips = 8;
+// The profile with the lowest time for this many round trips plus this much read back wins
+static const double workloadTrips = 64;
+static const double workloadBytes = 1048576;
+// ms to wait for any measurement
+static const unsigned int readTimeout = 1000;
+
+UsbTuner::Profile::Profile() {
+	latency = 16;
+	transferSize = 65536;
+	roundTrip = 0;
+	throughput = 0;
+}
+
+UsbTuner::UsbTuner(FT_HANDLE handle, RxEvent &event) :
+		rxEvent(event) {
+	ftHandle = handle;
+}
+
+// Applies the stored profile for this host and device, tuning and storing one
+// first if there isn't one. The latency timer is kept to maxLatency ms. The
+// MPSSE must be synced and nothing queued. If tuning fails the settings
+// profile came in with are put back.
+bool UsbTuner::select(Profile *profile, UCHAR maxLatency) {
+	Profile fallback = *profile;
+	string id = key();
+	string path = defaultPath();
+
+	if (load(path, id, profile)) {
+		if (profile->latency > maxLatency)
+			profile->latency = maxLatency;
+	} else {
+		if (!tune(profile, maxLatency)) {
+			*profile = fallback;
+			apply(ftHandle, fallback);
+			return false;
+		}
+		save(path, id, *profile);
+	}
+	return apply(ftHandle, *profile);
+}
+
+// Times every latency up to maxLatency with every transfer size and leaves the
+// best combination in profile
+bool UsbTuner::tune(Profile *profile, UCHAR maxLatency) {
+	bool found = false;
+	double bestCost = 0;
+
+	for (DWORD transferSize : transferSizes) {
+		for (UCHAR latency : latencies) {
+			if (latency > maxLatency)
+				continue;
+			Profile candidate;
+			candidate.latency = latency;
+			candidate.transferSize = transferSize;
+			if (!apply(ftHandle, candidate))
+				continue;
+			if (!measure(&candidate)) {
+				FT_Purge(ftHandle, FT_PURGE_RX); // drop anything that came in late
+				continue;
+			}
+
+			double cost = workloadTrips * candidate.roundTrip
+					+ workloadBytes / candidate.throughput;
+			if (!found || cost < bestCost) {
+				*profile = candidate;
+				bestCost = cost;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+bool UsbTuner::apply(FT_HANDLE handle, const Profile &profile) {
+	return FT_SetUSBParameters(handle, profile.transferSize,
+			profile.transferSize) == FT_OK
+			&& FT_SetLatencyTimer(handle, profile.latency) == FT_OK;
+}
+
+// Reads the low GPIO byte (0x81) to time the link. There's no send immediate
+// (0x87), it would return the reads straight away whatever the latency timer is.
+bool UsbTuner::measure(Profile *profile) {
+	BYTE command = 0x81;
+	vector<BYTE> bulk(bulkBytes, 0x81);
+	BYTE byInputBuffer[1];
+	DWORD dwNumBytesSent = 0;
+
+	get_time::time_point start = get_time::now();
+	for (unsigned int i = 0; i < roundTrips; i++) {
+		if (FT_Write(ftHandle, &command, 1, &dwNumBytesSent) != FT_OK
+				|| !rxEvent.read(byInputBuffer, 1, readTimeout))
+			return false;
+	}
+	profile->roundTrip =
+			chrono::duration<double>(get_time::now() - start).count()
+					/ roundTrips;
+
+	start = get_time::now();
+	if (FT_Write(ftHandle, bulk.data(), bulk.size(), &dwNumBytesSent) != FT_OK
+			|| !rxEvent.read(bulk.data(), bulkBytes, readTimeout))
+		return false;
+	double seconds = chrono::duration<double>(get_time::now() - start).count();
+	profile->throughput = bulkBytes / (seconds > 0 ? seconds : 1e-9);
+	return true;
+}
+
+// Identifies the host and device pair a profile belongs to
+string UsbTuner::key() {
+	char host[256] = "unknown";
+#ifdef _WIN32
+	const char *name = getenv("COMPUTERNAME");
+	if (name)
+		snprintf(host, sizeof(host), "%s", name);
+#else
+	if (gethostname(host, sizeof(host) - 1) != 0)
+		snprintf(host, sizeof(host), "unknown");
+#endif
+	string serial = serialNumber(ftHandle);
+	return string(host) + "/" + (serial.empty() ? "unknown" : serial);
+}
+
+// Serial number of the FTDI chip, empty if it can't be read
+string UsbTuner::serialNumber(FT_HANDLE handle) {
+	FT_DEVICE ftDevice;
+	DWORD deviceID;
+	char serial[16] = { };
+	char description[64];
+
+	if (FT_GetDeviceInfo(handle, &ftDevice, &deviceID, serial, description,
+			NULL) != FT_OK)
+		return "";
+	return serial;
+}
+
+// Per user file, next to the other dot files on Linux and in AppData on Windows
+string UsbTuner::defaultPath() {
+#ifdef _WIN32
+	const char *dir = getenv("APPDATA");
+	return dir ? string(dir) + "\\alchitry_loader_usb.txt" : "alchitry_loader_usb.txt";
+#else
+	const char *dir = getenv("HOME");
+	return dir ? string(dir) + "/.alchitry_loader_usb" : ".alchitry_loader_usb";
+#endif
+}
+
+// Each line is "host/serial latency transferSize"
+bool UsbTuner::load(string path, string id, Profile *profile) {
+	ifstream input(path);
+	string line;
+
+	while (getline(input, line)) {
+		istringstream fields(line);
+		string entry;
+		unsigned int latency;
+		DWORD transferSize;
+		if (!(fields >> entry >> latency >> transferSize) || entry != id)
+			continue;
+		if (latency < 1 || latency > 255 || transferSize < 64
+				|| transferSize > 65536)
+			continue;
+		profile->latency = latency;
+		profile->transferSize = transferSize;
+		return true;
+	}
+	return false;
+}
+
+bool UsbTuner::save(string path, string id, const Profile &profile) {
+	vector<string> lines;
+	ifstream input(path);
+	string line;
+
+	// keep the other hosts and devices
+	while (getline(input, line)) {
+		istringstream fields(line);
+		string entry;
+		if (fields >> entry && entry != id)
+			lines.push_back(line);
+	}
+	input.close();
+
+	ofstream output(path, ios::trunc);
+	if (!output.is_open()) {
+		cerr << "Failed to write USB profile " << path << endl;
+		return false;
+	}
+	for (string &kept : lines)
+		output << kept << endl;
+	output << id << " " << (unsigned int) profile.latency << " "
+			<< profile.transferSize << endl;
+	return output.good();
+}
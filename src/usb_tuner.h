@@ -0,0 +1,54 @@
+/*
+ * usb_tuner.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef USB_TUNER_H_
+#define USB_TUNER_H_
+
+#include "ftd2xx.h"
+#include "rx_event.h"
+#include <string>
+
+using namespace std;
+
+/*
+ * Picks the latency timer and USB transfer size for a connection. Every
+ * combination is timed with MPSSE GPIO reads, which return a byte each
+ * without clocking any pins, so it's safe with a target attached. The reads
+ * aren't followed by a send immediate so the latency timer decides when
+ * they come back, as it does for any read that doesn't flush itself. The best
+ * profile is stored per host and FTDI serial number and reused by later
+ * JTAG and SPI sessions, delete the file to tune again.
+ */
+class UsbTuner {
+public:
+	class Profile {
+	public:
+		UCHAR latency; // ms
+		DWORD transferSize; // bytes per USB request
+		double roundTrip; // seconds for a single byte read
+		double throughput; // bytes per second of bulk read back
+
+		Profile();
+	};
+
+	UsbTuner(FT_HANDLE, RxEvent&);
+	bool select(Profile*, UCHAR = 255);
+	bool tune(Profile*, UCHAR = 255);
+	static bool apply(FT_HANDLE, const Profile&);
+	static string serialNumber(FT_HANDLE);
+	static string defaultPath();
+
+private:
+	FT_HANDLE ftHandle;
+	RxEvent &rxEvent;
+
+	bool measure(Profile*);
+	string key();
+	static bool load(string, string, Profile*);
+	static bool save(string, string, const Profile&);
+};
+
+#endif /* USB_TUNER_H_ */
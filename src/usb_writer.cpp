@@ -0,0 +1,158 @@
+/*
+ * usb_writer.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "usb_writer.h"
+
+using namespace std;
+
+UsbWriter::UsbWriter() {
+	ftHandle = 0;
+	fill = 0;
+	pending = false;
+	running = false;
+	status = FT_OK;
+}
+
+UsbWriter::~UsbWriter() {
+	stop();
+}
+
+void UsbWriter::start(FT_HANDLE handle) {
+	stop();
+	ftHandle = handle;
+	status = FT_OK;
+	running = true;
+	worker = thread(&UsbWriter::run, this);
+}
+
+// Sizes both buffers for the largest batch up front so filling them never
+// allocates. Call it before start().
+void UsbWriter::reserve(size_t size) {
+	batches[0].bytes.reserve(size);
+	batches[1].bytes.reserve(size);
+}
+
+void UsbWriter::stop() {
+	if (!running)
+		return;
+	{
+		unique_lock<mutex> l(lock);
+		done.wait(l, [this] {return !pending;});
+		running = false;
+	}
+	ready.notify_one();
+	worker.join();
+}
+
+// Queues length bytes of caller memory without copying them
+void UsbWriter::reference(const BYTE *data, size_t length) {
+	Batch &out = batches[fill];
+	Reference ref;
+	ref.offset = out.bytes.size();
+	ref.data = data;
+	ref.length = length;
+	out.references.push_back(ref);
+	out.referenced += length;
+}
+
+// Hands the filled buffer to the worker once the previous one is out
+bool UsbWriter::submit() {
+	Batch &out = batches[fill];
+	if (out.bytes.empty() && out.references.empty())
+		return getStatus() == FT_OK;
+
+	if (!running) {
+		FT_STATUS ftStatus = write(out);
+		out.clear();
+		return ftStatus == FT_OK;
+	}
+
+	unique_lock<mutex> l(lock);
+	done.wait(l, [this] {return !pending;});
+	if (status != FT_OK) {
+		out.clear();
+		return false;
+	}
+	pending = true;
+	fill ^= 1;
+	batches[fill].clear();
+	l.unlock();
+	ready.notify_one();
+	return true;
+}
+
+// Blocks until everything submitted has been written
+bool UsbWriter::wait() {
+	unique_lock<mutex> l(lock);
+	done.wait(l, [this] {return !pending;});
+	return status == FT_OK;
+}
+
+// Blocks until no queued write points at caller memory so it can be freed
+bool UsbWriter::release() {
+	if (!batches[fill].references.empty() && !submit())
+		return false;
+
+	unique_lock<mutex> l(lock);
+	done.wait(l, [this] {return !pending || batches[fill ^ 1].references.empty();});
+	return status == FT_OK;
+}
+
+FT_STATUS UsbWriter::getStatus() {
+	lock_guard<mutex> l(lock);
+	return status;
+}
+
+void UsbWriter::run() {
+	unique_lock<mutex> l(lock);
+	while (true) {
+		ready.wait(l, [this] {return pending || !running;});
+		if (!pending)
+			break;
+
+		Batch &out = batches[fill ^ 1];
+		l.unlock();
+		FT_STATUS ftStatus = write(out);
+		l.lock();
+
+		if (status == FT_OK)
+			status = ftStatus;
+		pending = false;
+		done.notify_all();
+	}
+}
+
+// Writes the queued bytes with the references spliced in at their offsets
+FT_STATUS UsbWriter::write(const Batch &out) {
+	size_t offset = 0;
+	size_t ref = 0;
+	while (offset < out.bytes.size() || ref < out.references.size()) {
+		const BYTE *data;
+		size_t length;
+		if (ref < out.references.size()
+				&& out.references[ref].offset == offset) {
+			data = out.references[ref].data;
+			length = out.references[ref].length;
+			ref++;
+		} else {
+			size_t end =
+					ref < out.references.size() ?
+							out.references[ref].offset : out.bytes.size();
+			data = out.bytes.data() + offset;
+			length = end - offset;
+			offset = end;
+		}
+
+		DWORD dwNumBytesSent = 0;
+		FT_STATUS ftStatus = FT_Write(ftHandle, (LPVOID) data, length,
+				&dwNumBytesSent);
+		if (ftStatus != FT_OK)
+			return ftStatus;
+		if (dwNumBytesSent != length)
+			return FT_IO_ERROR;
+	}
+	return FT_OK;
+}
@@ -0,0 +1,96 @@
+/*
+ * usb_writer.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef USB_WRITER_H_
+#define USB_WRITER_H_
+
+#include "ftd2xx.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#ifdef _WIN32
+#include "mingw.thread.h"
+#else
+#include <thread>
+#endif
+
+using namespace std;
+
+/*
+ * Double buffered FT_Write. The caller fills one buffer while a worker thread
+ * writes the other one so framing the next chunk overlaps the USB transfer of
+ * the previous one. The first write error is kept and returned by submit()
+ * and wait() until the writer is restarted.
+ *
+ * Large payloads that already sit in caller memory can be referenced instead
+ * of copied. They are written in place between the queued bytes, so the memory
+ * has to stay valid until release() returns.
+ */
+class UsbWriter {
+	// Caller memory written after the first offset bytes of the batch
+	class Reference {
+	public:
+		size_t offset;
+		const BYTE *data;
+		size_t length;
+	};
+
+	// Everything handed to FT_Write in one submit
+	class Batch {
+	public:
+		vector<BYTE> bytes;
+		vector<Reference> references;
+		size_t referenced; // total length of the references
+
+		Batch() {
+			referenced = 0;
+		}
+		void clear() {
+			bytes.clear();
+			references.clear();
+			referenced = 0;
+		}
+	};
+
+	FT_HANDLE ftHandle;
+	Batch batches[2];
+	int fill; // index of the buffer the caller is filling
+	bool pending; // the other buffer has been handed to the worker and isn't written yet
+	bool running;
+	FT_STATUS status;
+	thread worker;
+	mutex lock;
+	condition_variable ready;
+	condition_variable done;
+
+public:
+	UsbWriter();
+	~UsbWriter();
+	void start(FT_HANDLE);
+	void reserve(size_t);
+	void stop();
+	bool submit();
+	bool wait();
+	bool release();
+	FT_STATUS getStatus();
+	void reference(const BYTE*, size_t);
+
+	vector<BYTE>& buffer() {
+		return batches[fill].bytes;
+	}
+	// Bytes queued in the batch being filled, referenced ones included
+	size_t size() const {
+		return batches[fill].bytes.size() + batches[fill].referenced;
+	}
+
+private:
+	UsbWriter(const UsbWriter&);
+	UsbWriter& operator=(const UsbWriter&);
+	void run();
+	FT_STATUS write(const Batch&);
+};
+
+#endif /* USB_WRITER_H_ */
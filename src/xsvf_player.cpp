@@ -0,0 +1,347 @@
+/*
+ * xsvf_player.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "xsvf_player.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+XsvfPlayer::XsvfPlayer(Jtag *dev) {
+	jtag = dev;
+	in = NULL;
+	position = 0;
+	command = 0;
+	sdrSize = 0;
+	repeat = 32; // the XSVF default until XREPEAT says otherwise
+	runTest = 0;
+	endIr = endDr = Jtag_fsm::RUN_TEST_IDLE;
+	segmentChecked = false;
+}
+
+bool XsvfPlayer::play(string file) {
+	ifstream stream(file, ios::in | ios::binary);
+	if (!stream.is_open()) {
+		cerr << "Failed to open file " << file << endl;
+		return false;
+	}
+	return play(stream);
+}
+
+// Runs every command up to XCOMPLETE or the end of the stream
+bool XsvfPlayer::play(istream &stream) {
+	bool done = false;
+	bool ok = true;
+
+	in = &stream;
+	position = 0;
+	jtag->setDeferChecks(true);
+
+	while (ok && !done) {
+		int code = in->get();
+		if (code == EOF)
+			break;
+		command = position++;
+		ok = execute(code, &done);
+	}
+
+	ok = ok && jtag->resolveChecks() && jtag->sendCommands();
+	jtag->setDeferChecks(false);
+	in = NULL;
+	return ok;
+}
+
+bool XsvfPlayer::execute(BYTE code, bool *done) {
+	BYTE value;
+	uint32_t integer;
+	BitBuffer tdi;
+
+	switch (code) {
+	case XCOMPLETE:
+		*done = true;
+		return true;
+	case XTDOMASK:
+		return readValue(sdrSize, &tdoMask);
+	case XSIR:
+		return readBytes(&value, 1) && shiftIr(value);
+	case XSIR2:
+		return readInteger(2, &integer) && shiftIr(integer);
+	case XSDR:
+		return readValue(sdrSize, &tdi) && shiftDr(tdi, true);
+	case XSDRTDO:
+		return readValue(sdrSize, &tdi) && readValue(sdrSize, &tdoExpected)
+				&& shiftDr(tdi, true);
+	case XRUNTEST:
+		if (!readInteger(4, &integer))
+			return false;
+		runTest = integer;
+		return true;
+	case XREPEAT:
+		if (!readBytes(&value, 1))
+			return false;
+		repeat = value;
+		return true;
+	case XSDRSIZE:
+		if (!readInteger(4, &integer))
+			return false;
+		// the old expected value and mask don't fit the new length, nothing is checked until they're set again
+		sdrSize = integer;
+		tdoExpected = BitBuffer(sdrSize);
+		tdoMask = BitBuffer(sdrSize);
+		return true;
+	case XSETSDRMASKS:
+		return readValue(sdrSize, &addressMask)
+				&& readValue(sdrSize, &dataMask);
+	case XSDRINC:
+		return sdrIncrement();
+	case XSDRB:
+	case XSDRC:
+	case XSDRE:
+	case XSDRTDOB:
+	case XSDRTDOC:
+	case XSDRTDOE:
+		return shiftSegment(code);
+	case XSTATE:
+		return readBytes(&value, 1) && moveTo(value);
+	case XENDIR:
+	case XENDDR:
+		if (!readBytes(&value, 1))
+			return false;
+		if (value > 1)
+			return error("Invalid end state");
+		if (code == XENDIR)
+			endIr = value ? Jtag_fsm::PAUSE_IR : Jtag_fsm::RUN_TEST_IDLE;
+		else
+			endDr = value ? Jtag_fsm::PAUSE_DR : Jtag_fsm::RUN_TEST_IDLE;
+		return true;
+	case XCOMMENT:
+		do {
+			if (!readBytes(&value, 1))
+				return false;
+		} while (value != 0);
+		return true;
+	case XWAIT: {
+		BYTE states[2];
+		return readBytes(states, 2) && readInteger(4, &integer)
+				&& moveTo(states[0]) && wait(integer) && moveTo(states[1]);
+	}
+	default:
+		stringstream message;
+		message << "Unknown command 0x" << hex << (int) code;
+		return error(message.str());
+	}
+}
+
+bool XsvfPlayer::readBytes(BYTE *data, size_t length) {
+	in->read((char*) data, length);
+	position += in->gcount();
+	if ((size_t) in->gcount() != length)
+		return error("Unexpected end of file");
+	return true;
+}
+
+// Integers are stored most significant byte first
+bool XsvfPlayer::readInteger(unsigned int bytes, uint32_t *value) {
+	BYTE data[4];
+	if (!readBytes(data, bytes))
+		return false;
+	*value = 0;
+	for (unsigned int i = 0; i < bytes; i++)
+		*value = *value << 8 | data[i];
+	return true;
+}
+
+// Values are stored most significant byte first, padded out to whole bytes
+bool XsvfPlayer::readValue(unsigned int bits, BitBuffer *value) {
+	*value = BitBuffer(bits);
+	if (!readBytes(value->data(), value->byteCount()))
+		return false;
+	value->reverseBytes();
+	value->resize(bits); // clear the padding
+	return true;
+}
+
+bool XsvfPlayer::shiftIr(unsigned int length) {
+	BitBuffer tdi;
+	if (!readValue(length, &tdi))
+		return false;
+	if (length == 0)
+		return true;
+	return jtag->navigateToState(Jtag_fsm::SHIFT_IR) && jtag->shiftData(tdi, NULL)
+			&& jtag->navigateToState(endIr) && idle(runTest);
+}
+
+// Shifts an XSDR style scan, checking TDO against the expected value where
+// XTDOMASK is set. With retries allowed a failed check is retried the way the
+// reference player does it: through PAUSE_DR back into SHIFT_DR without an
+// update, waiting a quarter longer each time. Those checks are read back
+// before moving on, any others are deferred.
+bool XsvfPlayer::shiftDr(const BitBuffer &tdi, bool compare) {
+	unsigned long delay = runTest;
+
+	if (tdi.empty())
+		return error("XSDRSIZE must be set before a data scan");
+
+	compare = compare
+			&& any_of(tdoMask.data(), tdoMask.data() + tdoMask.byteCount(),
+					[](BYTE b) {
+						return b != 0;
+					});
+
+	if (!compare || repeat == 0) {
+		if (!jtag->navigateToState(Jtag_fsm::SHIFT_DR))
+			return false;
+		bool ok = compare ?
+				jtag->shiftData(tdi, tdoExpected, tdoMask, checkName()) :
+				jtag->shiftData(tdi, NULL);
+		return ok && jtag->navigateToState(endDr) && idle(delay);
+	}
+
+	BitBuffer tdo; // reused by every attempt
+	for (unsigned int attempt = 0;; attempt++) {
+		if (!jtag->navigateToState(Jtag_fsm::SHIFT_DR)
+				|| !jtag->shiftData(tdi, &tdo))
+			return false;
+
+		unsigned int bit = BitBuffer::mismatch(tdo.data(), tdoExpected.data(),
+				tdoMask.data(), tdi.size());
+		if (bit == tdi.size() || attempt == repeat) {
+			if (!jtag->navigateToState(endDr) || !idle(delay))
+				return false;
+			if (bit == tdi.size())
+				return true;
+
+			stringstream message;
+			message << "TDO didn't match at bit " << bit << " after "
+					<< attempt + 1 << " tries. Got " << tdo.toHex()
+					<< " expected " << tdoExpected.toHex() << " with mask "
+					<< tdoMask.toHex();
+			return error(message.str());
+		}
+
+		// the wait is clocked in PAUSE_DR, going through RUN_TEST_IDLE would
+		// update the register with the failed data and capture it again
+		delay += delay / 4;
+		if (!jtag->navigateToState(Jtag_fsm::PAUSE_DR) || !wait(delay)
+				|| !jtag->navigateToState(Jtag_fsm::SHIFT_DR))
+			return false;
+	}
+}
+
+// XSDRB starts a scan that stays in SHIFT_DR, XSDRC adds to it and XSDRE ends
+// it. The pieces are joined and shifted as one scan when the end arrives, which
+// is the same on the wire. The TDO versions check every bit of their piece.
+bool XsvfPlayer::shiftSegment(BYTE code) {
+	bool checked = code >= XSDRTDOB;
+	BitBuffer tdi;
+	BitBuffer tdo(sdrSize);
+
+	if (!readValue(sdrSize, &tdi) || (checked && !readValue(sdrSize, &tdo)))
+		return false;
+
+	if (code == XSDRB || code == XSDRTDOB) {
+		segmentTdi = BitBuffer();
+		segmentTdo = BitBuffer();
+		segmentMask = BitBuffer();
+		segmentChecked = false;
+	}
+	segmentTdi.append(tdi);
+	segmentTdo.append(tdo);
+	segmentMask.append(checked ? BitBuffer::ones(sdrSize) : BitBuffer(sdrSize));
+	segmentChecked = segmentChecked || checked;
+
+	if (code != XSDRE && code != XSDRTDOE)
+		return true;
+	if (segmentTdi.empty())
+		return error("XSDRSIZE must be set before a data scan");
+
+	bool ok = jtag->navigateToState(Jtag_fsm::SHIFT_DR)
+			&& (segmentChecked ?
+					jtag->shiftData(segmentTdi, segmentTdo, segmentMask,
+							checkName()) :
+					jtag->shiftData(segmentTdi, NULL));
+	segmentTdi = BitBuffer();
+	segmentTdo = BitBuffer();
+	segmentMask = BitBuffer();
+	return ok && jtag->navigateToState(endDr) && idle(runTest);
+}
+
+// XSDRINC shifts a start value then count more, each with the XSETSDRMASKS
+// address field incremented and the next data value spread over the data field
+bool XsvfPlayer::sdrIncrement() {
+	BitBuffer tdi;
+	BYTE count;
+
+	if (!readValue(sdrSize, &tdi) || !readBytes(&count, 1))
+		return false;
+	if (addressMask.size() != sdrSize || dataMask.size() != sdrSize)
+		return error("XSETSDRMASKS must be set before XSDRINC");
+	if (!shiftDr(tdi, true))
+		return false;
+
+	unsigned int dataBits = 0;
+	for (unsigned int i = 0; i < sdrSize; i++)
+		dataBits += dataMask.getBit(i);
+
+	for (unsigned int n = 0; n < count; n++) {
+		BitBuffer data;
+		if (!readValue(dataBits, &data))
+			return false;
+
+		// add one to the address bits, carrying from the lowest
+		for (unsigned int i = 0; i < sdrSize; i++) {
+			if (!addressMask.getBit(i))
+				continue;
+			bool carry = tdi.getBit(i);
+			tdi.setBit(i, !carry);
+			if (!carry)
+				break;
+		}
+
+		for (unsigned int i = 0, j = 0; i < sdrSize; i++)
+			if (dataMask.getBit(i))
+				tdi.setBit(i, data.getBit(j++));
+
+		if (!shiftDr(tdi, true))
+			return false;
+	}
+	return true;
+}
+
+// XSTATE and XWAIT use the same state numbers as Jtag_fsm, reset is always five TMS high clocks
+bool XsvfPlayer::moveTo(BYTE state) {
+	if (state > Jtag_fsm::UPDATE_IR)
+		return error("Invalid state");
+	if (state == Jtag_fsm::TEST_LOGIC_RESET)
+		return jtag->resetState();
+	return jtag->navigateToState((Jtag_fsm::State) state);
+}
+
+// Waits are clocked out on TCK so they're queued with everything else instead of sleeping
+bool XsvfPlayer::wait(unsigned long microseconds) {
+	return jtag->sendClocks(ceil(microseconds * jtag->getFreq() / 1000000.0));
+}
+
+// The XRUNTEST wait after a scan, spent in RUN_TEST_IDLE
+bool XsvfPlayer::idle(unsigned long microseconds) {
+	if (microseconds == 0)
+		return true;
+	return jtag->navigateToState(Jtag_fsm::RUN_TEST_IDLE) && wait(microseconds);
+}
+
+// Failed checks are reported with the offset of the command they came from
+string XsvfPlayer::checkName() {
+	return "XSVF command at byte " + to_string(command);
+}
+
+bool XsvfPlayer::error(const string &message) {
+	cerr << "XSVF error in the command at byte " << command << ": " << message
+			<< endl;
+	return false;
+}
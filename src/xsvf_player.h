@@ -0,0 +1,90 @@
+/*
+ * xsvf_player.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef XSVF_PLAYER_H_
+#define XSVF_PLAYER_H_
+
+#include "jtag.h"
+#include "jtag_fsm.h"
+#include "bit_buffer.h"
+#include <stdint.h>
+#include <istream>
+#include <string>
+
+using namespace std;
+
+/*
+ * Plays Xilinx XSVF files, the binary form of SVF. Commands are read straight
+ * from the stream and queued on Jtag like the SVF player does. TDO checks are
+ * deferred and read back in batches unless XREPEAT allows retries, since a
+ * retry depends on the result of the scan before it.
+ */
+class XsvfPlayer {
+	Jtag *jtag;
+	istream *in;
+	size_t position; // bytes read from the stream
+	size_t command; // offset of the command being run, reported on errors
+	unsigned int sdrSize; // length of every XSDR style scan
+	BitBuffer tdoMask;
+	BitBuffer tdoExpected;
+	BitBuffer addressMask; // XSDRINC fields, set by XSETSDRMASKS
+	BitBuffer dataMask;
+	unsigned int repeat; // times a failed check is retried
+	unsigned long runTest; // microseconds in RUN_TEST_IDLE after each scan
+	Jtag_fsm::State endIr;
+	Jtag_fsm::State endDr;
+	BitBuffer segmentTdi; // XSDRB, XSDRC and XSDRE pieces joined into one scan
+	BitBuffer segmentTdo;
+	BitBuffer segmentMask;
+	bool segmentChecked;
+
+public:
+	XsvfPlayer(Jtag*);
+	bool play(string);
+	bool play(istream&);
+
+private:
+	enum Command {
+		XCOMPLETE = 0x00,
+		XTDOMASK = 0x01,
+		XSIR = 0x02,
+		XSDR = 0x03,
+		XRUNTEST = 0x04,
+		XREPEAT = 0x07,
+		XSDRSIZE = 0x08,
+		XSDRTDO = 0x09,
+		XSETSDRMASKS = 0x0A,
+		XSDRINC = 0x0B,
+		XSDRB = 0x0C,
+		XSDRC = 0x0D,
+		XSDRE = 0x0E,
+		XSDRTDOB = 0x0F,
+		XSDRTDOC = 0x10,
+		XSDRTDOE = 0x11,
+		XSTATE = 0x12,
+		XENDIR = 0x13,
+		XENDDR = 0x14,
+		XSIR2 = 0x15,
+		XCOMMENT = 0x16,
+		XWAIT = 0x17
+	};
+
+	bool execute(BYTE, bool*);
+	bool readBytes(BYTE*, size_t);
+	bool readInteger(unsigned int, uint32_t*);
+	bool readValue(unsigned int, BitBuffer*);
+	bool shiftIr(unsigned int);
+	bool shiftDr(const BitBuffer&, bool);
+	bool shiftSegment(BYTE);
+	bool sdrIncrement();
+	bool moveTo(BYTE);
+	bool wait(unsigned long);
+	bool idle(unsigned long);
+	string checkName();
+	bool error(const string&);
+};
+
+#endif /* XSVF_PLAYER_H_ */
@@ -0,0 +1,108 @@
+/*
+ * bsdl_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "tests.h"
+#include "ftd2xx_stub.h"
+#include "boundary_scan.h"
+#include "bsdl.h"
+
+using namespace std;
+
+// Checked in next to the tests, CMake passes the directory
+static const string fixture = string(TEST_DIR) + "/test_device.bsd";
+
+static void testParse(Bsdl &bsdl) {
+	uint32_t opcode = 0;
+	check(bsdl.getEntity() == "TEST_DEVICE", "bsdl: entity");
+	check(bsdl.getIrLength() == 6, "bsdl: instruction length");
+	check(bsdl.getBoundaryLength() == 8, "bsdl: boundary length");
+
+	// the opcodes are spread over & joined strings, SAMPLE lists two
+	check(bsdl.getOpcode("EXTEST", &opcode) && opcode == 0x26, "bsdl: EXTEST");
+	check(bsdl.getOpcode("sample", &opcode) && opcode == 0x01, "bsdl: SAMPLE");
+	check(bsdl.getOpcode("BYPASS", &opcode) && opcode == 0x3F, "bsdl: BYPASS");
+	check(bsdl.getOpcode("IDCODE", &opcode) && opcode == 0x09, "bsdl: IDCODE");
+	check(!bsdl.getOpcode("HIGHZ", &opcode), "bsdl: missing opcode");
+	check(bsdl.matchesIdcode(0x0362D093) && bsdl.matchesIdcode(0x5362D093)
+			&& !bsdl.matchesIdcode(0x0362C093), "bsdl: IDCODE with X version");
+
+	const vector<Bsdl::Cell> &cells = bsdl.getCells();
+	if (!check(cells.size() == 8, "bsdl: cells"))
+		return;
+	check(cells[7].port == "*" && cells[7].function == Bsdl::CONTROLR
+			&& cells[7].safe && cells[7].control == -1, "bsdl: control cell");
+	check(cells[6].port == "LED" && cells[6].function == Bsdl::OUTPUT3
+			&& cells[6].control == 7 && cells[6].disable,
+			"bsdl: output disabled by 1");
+	check(cells[1].port == "DATA(0)" && cells[1].function == Bsdl::BIDIR
+			&& cells[1].control == 2 && !cells[1].disable,
+			"bsdl: bidir disabled by 0");
+	check(cells[3].port == "DATA(1)" && cells[3].function == Bsdl::INPUT
+			&& !cells[3].safe && cells[3].control == -1, "bsdl: input cell");
+
+	// the pins come from PKG_B, the package the PHYSICAL_PIN_MAP generic names
+	const vector<Bsdl::Pin> &pins = bsdl.getPins();
+	int data0 = bsdl.findPin("data(0)");
+	int data1 = bsdl.findPin("DATA(1)");
+	int led = bsdl.findPin("LED");
+	int clk = bsdl.findPin("B1");
+	if (!check(data0 >= 0 && data1 >= 0 && led >= 0 && clk >= 0,
+			"bsdl: finding pins"))
+		return;
+	check(pins[data0].ball == "B2" && pins[data0].input == 1
+			&& pins[data0].output == 1, "bsdl: bidir pin");
+	check(pins[data1].ball == "B3" && pins[data1].input == 3
+			&& pins[data1].output == 4, "bsdl: vector pin split over strings");
+	check(pins[led].ball == "B4" && pins[led].input == -1
+			&& pins[led].output == 6, "bsdl: output pin");
+	check(pins[clk].port == "CLK" && pins[clk].input == 0
+			&& pins[clk].output == -1, "bsdl: input pin");
+	check(bsdl.findPin("b3") == data1, "bsdl: pin by package pin");
+	check(bsdl.findPin("A3") == -1, "bsdl: other package");
+	check(bsdl.findPin("TDI") == -1, "bsdl: pin without cells");
+}
+
+// The stub's test register captures whatever the scan before updated it with,
+// which is what a bidir cell wired straight to its pin reads under EXTEST. So
+// the capture of scan i has to come back as the result of vector i - 1.
+static void testRun(Jtag &jtag, Bsdl &bsdl) {
+	if (!check(selectDevice(jtag, { 6 }, 0, 8), "boundary scan: selecting"))
+		return;
+
+	BoundaryScan scan(&jtag, &bsdl);
+	if (!check(scan.setPins({ "DATA(0)", "B3" }) && scan.pinCount() == 2
+			&& scan.pinName(1) == "B3 (DATA(1))", "boundary scan: pins"))
+		return;
+
+	// DATA(0) drives 1 0 0 1, DATA(1) samples a cell that's never driven
+	vector<BoundaryScan::Vector> vectors = BoundaryScan::countingSequence(2);
+	vector<BitBuffer> results;
+	check(scan.enter() && scan.run(vectors, &results), "boundary scan: run");
+	if (!check(results.size() == vectors.size(), "boundary scan: results"))
+		return;
+	for (unsigned int i = 0; i < vectors.size(); i++)
+		check(results[i].getBit(0) == vectors[i].drive.getBit(0)
+				&& !results[i].getBit(1),
+				"boundary scan: result of vector " + to_string(i));
+
+	// the last scan leaves every output off
+	const vector<bool> &data = StubChain::device(0).data;
+	bool safe = true;
+	for (unsigned int i = 0; i < data.size(); i++)
+		safe = safe && data[i] == (i == 5 || i == 7);
+	check(safe, "boundary scan: safe values after the run");
+	check(scan.exit() && StubChain::device(0).bypassed(),
+			"boundary scan: exit");
+	check(!StubChain::failed(), "boundary scan: MPSSE commands");
+}
+
+void testBsdl(Jtag &jtag) {
+	Bsdl bsdl;
+	if (!check(bsdl.load(fixture), "bsdl: loading " + fixture))
+		return;
+	testParse(bsdl);
+	testRun(jtag, bsdl);
+}
@@ -0,0 +1,267 @@
+/*
+ * config_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "tests.h"
+#include "bit_file.h"
+#include "config_packets.h"
+#include "config_registers.h"
+#include <cstdio>
+#include <iostream>
+#include <stdint.h>
+
+using namespace std;
+
+static const uint32_t idcode = 0x0362D093; // XC7A35T
+static const char *streamFile = "config_test.bin";
+
+// Streams are built a word at a time, most significant byte first
+static void word(vector<BYTE> &stream, uint32_t value) {
+	for (int shift = 24; shift >= 0; shift -= 8)
+		stream.push_back(value >> shift);
+}
+
+static uint32_t typeOne(ConfigPackets::Opcode op, unsigned int reg,
+		unsigned int words) {
+	return 1u << 29 | op << 27 | reg << 13 | words;
+}
+
+static uint32_t typeTwo(ConfigPackets::Opcode op, unsigned int words) {
+	return 2u << 29 | op << 27 | words;
+}
+
+static void write(vector<BYTE> &stream, unsigned int reg, uint32_t value) {
+	word(stream, typeOne(ConfigPackets::WRITE, reg, 1));
+	word(stream, value);
+}
+
+// Dummy words, the bus width pattern, the sync word and then the packets up to
+// the frame data. A stream without sync leaves the sync word out.
+static vector<BYTE> header(bool sync) {
+	vector<BYTE> stream;
+	word(stream, 0xFFFFFFFF);
+	word(stream, 0x000000BB);
+	word(stream, 0x11220044);
+	word(stream, 0xFFFFFFFF);
+	if (sync)
+		word(stream, 0xAA995566);
+	word(stream, 0x20000000); // NOOP
+	write(stream, ConfigPackets::IDCODE, idcode);
+	write(stream, ConfigPackets::CMD, ConfigPackets::WCFG);
+	return stream;
+}
+
+// Frame data in a type 1 FDRI write of no words and the type 2 packet after it,
+// then START and DESYNC. What follows DESYNC isn't a valid header.
+static vector<BYTE> bitstream(size_t frameWords, bool sync = true) {
+	vector<BYTE> stream = header(sync);
+	word(stream, typeOne(ConfigPackets::WRITE, ConfigPackets::FDRI, 0));
+	word(stream, typeTwo(ConfigPackets::WRITE, frameWords));
+	for (size_t i = 0; i < frameWords; i++)
+		word(stream, i);
+	write(stream, ConfigPackets::CMD, ConfigPackets::START);
+	write(stream, ConfigPackets::CMD, ConfigPackets::DESYNC);
+	word(stream, 0x20000000);
+	word(stream, 0xFFFFFFFF);
+	return stream;
+}
+
+// BitstreamSource only reads files so the bytes go through one
+static bool openStream(BitstreamSource &source, const vector<BYTE> &stream) {
+	FILE *file = fopen(streamFile, "wb");
+	if (file == NULL)
+		return false;
+	bool written = fwrite(stream.data(), 1, stream.size(), file) == stream.size();
+	return fclose(file) == 0 && written && source.open(streamFile);
+}
+
+static bool parse(const vector<BYTE> &stream, ConfigPackets &packets) {
+	BitstreamSource source;
+	return openStream(source, stream) && packets.parse(source);
+}
+
+static void testPackets() {
+	const size_t frameWords = 2 * ConfigPackets::frameWords;
+	ConfigPackets packets;
+	if (!check(parse(bitstream(frameWords), packets), "packets: parse"))
+		return;
+
+	// IDCODE, WCFG, both FDRI packets, START and DESYNC
+	const vector<ConfigPackets::Packet> &list = packets.getPackets();
+	check(packets.getSyncOffset() == 16, "packets: sync offset");
+	if (!check(list.size() == 6,
+			"packets: " + to_string(list.size()) + " packets"))
+		return;
+	check(list[0].type == 1 && list[0].op == ConfigPackets::WRITE
+			&& list[0].reg == ConfigPackets::IDCODE && list[0].words == 1
+			&& list[0].value == idcode, "packets: type 1 write");
+	check(list[2].type == 1 && list[2].reg == ConfigPackets::FDRI
+			&& list[2].words == 0 && list[2].value == 0,
+			"packets: type 1 write without data");
+	check(list[3].type == 2 && list[3].reg == ConfigPackets::FDRI
+			&& list[3].words == frameWords && list[3].offset == list[2].offset + 4,
+			"packets: type 2 write takes the type 1 register");
+	check(list[5].reg == ConfigPackets::CMD
+			&& list[5].value == ConfigPackets::DESYNC, "packets: stop at DESYNC");
+
+	check(packets.getFrameWords() == frameWords, "packets: frame words");
+	check(packets.hasCommand(ConfigPackets::START)
+			&& !packets.hasCommand(ConfigPackets::RCRC), "packets: commands");
+	size_t frames = list[3].offset + 4;
+	check(packets.frameProgress(frames) == 0
+			&& packets.frameProgress(frames + frameWords * 2) == 0.5
+			&& packets.frameProgress(frames + frameWords * 4) == 1,
+			"packets: frame progress");
+
+	check(packets.validate(idcode), "packets: validate");
+	check(packets.validate(0), "packets: validate without IDCODE");
+	check(packets.validate(idcode | 0x10000000), "packets: other revision");
+	cerr << "(the next bitstream errors are expected)" << endl;
+	check(!packets.validate(0x0362C093), "packets: IDCODE mismatch");
+
+	check(!parse(bitstream(frameWords, false), packets), "packets: no sync");
+
+	check(parse(bitstream(frameWords - 50), packets)
+			&& !packets.validate(idcode), "packets: short FDRI");
+
+	vector<BYTE> truncated = bitstream(frameWords);
+	truncated.resize(frames + 100 * 4);
+	check(!parse(truncated, packets), "packets: truncated FDRI");
+
+	// a NOOP is a type 1 packet too so the type 2 comes straight after sync
+	vector<BYTE> orphan = header(true);
+	orphan.erase(orphan.end() - 20, orphan.end());
+	word(orphan, typeTwo(ConfigPackets::WRITE, 1));
+	word(orphan, 0);
+	check(!parse(orphan, packets), "packets: type 2 without type 1");
+
+	vector<BYTE> noStart = header(true);
+	word(noStart, typeOne(ConfigPackets::WRITE, ConfigPackets::FDRI, 0));
+	word(noStart, typeTwo(ConfigPackets::WRITE, frameWords));
+	noStart.resize(noStart.size() + frameWords * 4);
+	check(parse(noStart, packets) && !packets.validate(idcode),
+			"packets: no START");
+}
+
+// A .bit header, key and two byte length for each string then key e and the
+// four byte length of the data
+static vector<BYTE> bitHeader(size_t dataLength, char lastKey = 'd') {
+	const BYTE preamble[] = { 0x00, 0x09, 0x0F, 0xF0, 0x0F, 0xF0, 0x0F, 0xF0,
+			0x0F, 0xF0, 0x00, 0x00, 0x01 };
+	const char *fields[] = { "alchitry;UserID=0XFFFFFFFF;Version=2026.1",
+			"7a35tftg256", "2026/10/16", "12:34:56" };
+	vector<BYTE> header(preamble, preamble + sizeof(preamble));
+	for (char key = 'a'; key <= lastKey; key++) {
+		string value = fields[key - 'a'];
+		header.push_back(key);
+		header.push_back((value.size() + 1) >> 8);
+		header.push_back(value.size() + 1);
+		header.insert(header.end(), value.begin(), value.end());
+		header.push_back(0);
+	}
+	header.push_back('e');
+	word(header, dataLength);
+	return header;
+}
+
+static void testBitFile() {
+	vector<BYTE> data = bitstream(ConfigPackets::frameWords);
+	vector<BYTE> file = bitHeader(data.size());
+	size_t headerLength = file.size();
+	file.insert(file.end(), data.begin(), data.end());
+
+	BitstreamSource source;
+	BitFile bit;
+	if (!check(openStream(source, file), "bit file: open"))
+		return;
+	check(BitFile::hasHeader(source) && source.tell() == 0,
+			"bit file: has header");
+	check(bit.read(source), "bit file: read");
+	check(bit.design == "alchitry;UserID=0XFFFFFFFF;Version=2026.1"
+			&& bit.part == "7a35tftg256" && bit.date == "2026/10/16"
+			&& bit.time == "12:34:56", "bit file: fields");
+	check(source.tell() == headerLength && source.remaining() == data.size(),
+			"bit file: left at the data");
+
+	// the packets are parsed straight from the same source
+	ConfigPackets packets;
+	check(packets.parse(source)
+			&& packets.getSyncOffset() == headerLength + 16
+			&& packets.validate(idcode), "bit file: packets after the header");
+	source.close();
+
+	check(openStream(source, data) && !BitFile::hasHeader(source)
+			&& source.tell() == 0, "bit file: raw bitstream");
+	source.close();
+
+	cerr << "(the next bit file errors are expected)" << endl;
+	file = bitHeader(data.size() + 4);
+	file.insert(file.end(), data.begin(), data.end());
+	check(openStream(source, file) && !bit.read(source),
+			"bit file: data length mismatch");
+	source.close();
+
+	file = bitHeader(data.size(), 'b');
+	file.insert(file.end() - 5, 'z');
+	file.insert(file.end(), data.begin(), data.end());
+	check(openStream(source, file) && !bit.read(source),
+			"bit file: unknown field");
+	source.close();
+
+	file = bitHeader(data.size());
+	file.resize(30);
+	check(openStream(source, file) && !bit.read(source),
+			"bit file: truncated header");
+	source.close();
+	remove(streamFile);
+}
+
+// STAT values with the given bits set and the startup state field in Gray code
+static uint32_t stat(initializer_list<ConfigRegisters::Status> bits,
+		unsigned int gray = 0) {
+	uint32_t value = gray << 18;
+	for (ConfigRegisters::Status bit : bits)
+		value |= 1u << bit;
+	return value;
+}
+
+static bool diagnosed(uint32_t value, const string &text) {
+	return ConfigRegisters::diagnose(value).find(text) != string::npos;
+}
+
+static void testDiagnose() {
+	using R = ConfigRegisters;
+	const uint32_t initialized = stat({ R::INIT_COMPLETE, R::INIT_B });
+
+	check(R::startupState(stat({}, 2)) == 3 && R::startupState(stat({}, 4)) == 7,
+			"diagnose: startup state");
+	check(R::diagnose(initialized | stat({ R::DONE }, 4)).empty(),
+			"diagnose: done");
+	check(diagnosed(initialized | stat({ R::ID_ERROR, R::CRC_ERROR }),
+			"ID_ERROR"), "diagnose: ID_ERROR first");
+	check(diagnosed(initialized | stat({ R::CRC_ERROR }), "CRC_ERROR"),
+			"diagnose: CRC_ERROR");
+	check(diagnosed(initialized | stat({ R::DEC_ERROR }), "DEC_ERROR"),
+			"diagnose: DEC_ERROR");
+	check(diagnosed(initialized | stat({ R::XADC_OVER_TEMP }), "XADC_OVER_TEMP"),
+			"diagnose: XADC_OVER_TEMP");
+	check(diagnosed(stat({ R::INIT_B }), "INIT_COMPLETE"),
+			"diagnose: INIT_COMPLETE low");
+	check(diagnosed(stat({ R::INIT_COMPLETE }), "INIT_B"),
+			"diagnose: INIT_B low");
+	check(diagnosed(initialized, "never began"), "diagnose: no startup");
+	check(diagnosed(initialized | stat({ R::DCI_MATCH }, 3), "LCK_cycle"),
+			"diagnose: waiting for an MMCM");
+	check(diagnosed(initialized | stat({ R::MMCM_LOCK }, 3), "Match_cycle"),
+			"diagnose: waiting for DCI");
+	check(diagnosed(initialized | stat({ R::MMCM_LOCK, R::DCI_MATCH }, 6),
+			"phase 4"), "diagnose: stuck phase");
+}
+
+void testConfig() {
+	testPackets();
+	testBitFile();
+	testDiagnose();
+}
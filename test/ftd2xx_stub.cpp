@@ -0,0 +1,395 @@
+/*
+ * ftd2xx_stub.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "ftd2xx_stub.h"
+#include "ftd2xx.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+using namespace std;
+
+typedef Jtag_fsm::State State;
+
+// TAP state after a clock with TMS low and high (IEEE 1149.1 figure 6-1)
+static const State nextState[16][2] = {
+		{ Jtag_fsm::RUN_TEST_IDLE, Jtag_fsm::TEST_LOGIC_RESET },
+		{ Jtag_fsm::RUN_TEST_IDLE, Jtag_fsm::SELECT_DR_SCAN },
+		{ Jtag_fsm::CAPTURE_DR, Jtag_fsm::SELECT_IR_SCAN },
+		{ Jtag_fsm::SHIFT_DR, Jtag_fsm::EXIT1_DR },
+		{ Jtag_fsm::SHIFT_DR, Jtag_fsm::EXIT1_DR },
+		{ Jtag_fsm::PAUSE_DR, Jtag_fsm::UPDATE_DR },
+		{ Jtag_fsm::PAUSE_DR, Jtag_fsm::EXIT2_DR },
+		{ Jtag_fsm::SHIFT_DR, Jtag_fsm::UPDATE_DR },
+		{ Jtag_fsm::RUN_TEST_IDLE, Jtag_fsm::SELECT_DR_SCAN },
+		{ Jtag_fsm::CAPTURE_IR, Jtag_fsm::TEST_LOGIC_RESET },
+		{ Jtag_fsm::SHIFT_IR, Jtag_fsm::EXIT1_IR },
+		{ Jtag_fsm::SHIFT_IR, Jtag_fsm::EXIT1_IR },
+		{ Jtag_fsm::PAUSE_IR, Jtag_fsm::UPDATE_IR },
+		{ Jtag_fsm::PAUSE_IR, Jtag_fsm::EXIT2_IR },
+		{ Jtag_fsm::SHIFT_IR, Jtag_fsm::UPDATE_IR },
+		{ Jtag_fsm::RUN_TEST_IDLE, Jtag_fsm::SELECT_DR_SCAN } };
+
+static mutex stubMutex; // guards everything below, FT_Write runs on the writer thread
+static condition_variable rxReady;
+static vector<StubChain::Device> devices;
+static unsigned int dataLength;
+static State tap = Jtag_fsm::TEST_LOGIC_RESET;
+static bool tms = true; // held between commands like the MPSSE does
+static unsigned long shiftCount; // SHIFT_DR clocks since the last CAPTURE_DR
+static unsigned long updateCount; // UPDATE_DR clocks since the chain was reset
+static unsigned long idleCount; // clocks that stayed in RUN_TEST_IDLE since the reset
+static bool badCommand;
+static vector<BYTE> partial; // a command split across two writes
+static deque<BYTE> rx;
+static ULONG readTimeout = 5000;
+static PVOID notify; // the RxEvent passed to FT_SetEventNotification
+
+bool StubChain::Device::bypassed() const {
+	return instruction == (1u << irLength) - 1;
+}
+
+// A chain with one device per IR length, each test register dataLength bits
+void StubChain::reset(const vector<unsigned int> &irLengths,
+		unsigned int length) {
+	lock_guard<mutex> lock(stubMutex);
+	devices.clear();
+	for (unsigned int irLength : irLengths) {
+		Device d;
+		d.irLength = irLength;
+		d.instruction = (1u << irLength) - 1;
+		d.data.assign(length, false);
+		devices.push_back(d);
+	}
+	dataLength = length;
+	tap = Jtag_fsm::TEST_LOGIC_RESET;
+	shiftCount = 0;
+	updateCount = 0;
+	idleCount = 0;
+	badCommand = false;
+}
+
+StubChain::Device& StubChain::device(unsigned int i) {
+	lock_guard<mutex> lock(stubMutex);
+	return devices[i];
+}
+
+Jtag_fsm::State StubChain::state() {
+	lock_guard<mutex> lock(stubMutex);
+	return tap;
+}
+
+// Clocks spent in SHIFT_DR during the last DR scan, the data plus every pad bit
+unsigned long StubChain::lastShift() {
+	lock_guard<mutex> lock(stubMutex);
+	return shiftCount;
+}
+
+// Times the chain has passed through UPDATE_DR
+unsigned long StubChain::updates() {
+	lock_guard<mutex> lock(stubMutex);
+	return updateCount;
+}
+
+// Clocks spent waiting in RUN_TEST_IDLE, not counting the ones that leave it
+unsigned long StubChain::idleClocks() {
+	lock_guard<mutex> lock(stubMutex);
+	return idleCount;
+}
+
+// True once the stub has been sent a command it doesn't know
+bool StubChain::failed() {
+	lock_guard<mutex> lock(stubMutex);
+	return badCommand;
+}
+
+// Moves every register one bit towards TDO, returning the bit that falls off
+static bool shiftChain(bool tdi) {
+	bool tdo = devices[0].shift.front();
+	for (size_t i = 0; i < devices.size(); i++) {
+		bool in = i + 1 < devices.size() ? devices[i + 1].shift.front() : tdi;
+		devices[i].shift.pop_front();
+		devices[i].shift.push_back(in);
+	}
+	return tdo;
+}
+
+// One rising TCK edge, returns TDO as it was before the edge
+static bool clock(bool tdi) {
+	bool tdo = false;
+	switch (tap) {
+	case Jtag_fsm::TEST_LOGIC_RESET:
+		for (StubChain::Device &d : devices)
+			d.instruction = (1u << d.irLength) - 1;
+		break;
+	case Jtag_fsm::CAPTURE_DR:
+		for (StubChain::Device &d : devices) {
+			if (d.bypassed())
+				d.shift.assign(1, false);
+			else
+				d.shift.assign(d.data.begin(), d.data.end());
+		}
+		shiftCount = 0;
+		break;
+	case Jtag_fsm::CAPTURE_IR:
+		for (StubChain::Device &d : devices) {
+			d.shift.assign(d.irLength, false);
+			d.shift[0] = true;
+		}
+		break;
+	case Jtag_fsm::SHIFT_DR:
+		shiftCount++;
+		tdo = shiftChain(tdi);
+		break;
+	case Jtag_fsm::SHIFT_IR:
+		tdo = shiftChain(tdi);
+		break;
+	case Jtag_fsm::UPDATE_DR:
+		updateCount++;
+		for (StubChain::Device &d : devices)
+			if (!d.bypassed())
+				d.data.assign(d.shift.begin(), d.shift.end());
+		break;
+	case Jtag_fsm::UPDATE_IR:
+		for (StubChain::Device &d : devices) {
+			d.instruction = 0;
+			for (unsigned int i = 0; i < d.irLength; i++)
+				d.instruction |= d.shift[i] << i;
+		}
+		break;
+	default:
+		break;
+	}
+	if (tap == Jtag_fsm::RUN_TEST_IDLE && !tms)
+		idleCount++;
+	tap = nextState[tap][tms];
+	return tdo;
+}
+
+// Length of the MPSSE command at the start of p, 0 if it isn't all there yet
+static size_t commandLength(const BYTE *p, size_t n) {
+	switch (p[0] & ~0x08) {
+	case 0x11:
+	case 0x31:
+		return n < 3 ? 0 : 3 + (p[1] | (p[2] << 8)) + 1;
+	case 0x13:
+	case 0x33:
+		return 3;
+	}
+	switch (p[0]) {
+	case 0x4B:
+	case 0x6E:
+	case 0x80:
+	case 0x82:
+	case 0x86:
+	case 0x8F:
+		return 3;
+	case 0x8E:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+static void execute(const BYTE *p) {
+	BYTE command = p[0];
+	bool lsb = command & 0x08;
+	bool read = command & 0x20;
+	switch (command & ~0x08) {
+	case 0x11:
+	case 0x31: {
+		unsigned int length = (p[1] | (p[2] << 8)) + 1;
+		for (unsigned int i = 0; i < length; i++) {
+			BYTE out = 0;
+			for (int bit = 0; bit < 8; bit++) {
+				int shift = lsb ? bit : 7 - bit;
+				out |= clock((p[3 + i] >> shift) & 1) << shift;
+			}
+			if (read)
+				rx.push_back(out);
+		}
+		return;
+	}
+	case 0x13:
+	case 0x33: {
+		BYTE out = 0;
+		for (int bit = 0; bit <= p[1]; bit++) {
+			bool tdo = clock((p[2] >> (lsb ? bit : 7 - bit)) & 1);
+			out = lsb ? (out >> 1) | (tdo << 7) : (out << 1) | tdo;
+		}
+		if (read)
+			rx.push_back(out);
+		return;
+	}
+	}
+	switch (command) {
+	case 0x4B:
+	case 0x6E: {
+		BYTE out = 0;
+		for (int bit = 0; bit <= p[1]; bit++) {
+			tms = (p[2] >> bit) & 1;
+			out = (out >> 1) | (clock(p[2] >> 7) << 7);
+		}
+		if (read)
+			rx.push_back(out);
+		return;
+	}
+	case 0x8F:
+		for (unsigned long i = 0; i < ((p[1] | (p[2] << 8)) + 1) * 8ul; i++)
+			clock(false);
+		return;
+	case 0x8E:
+		for (int i = 0; i <= p[1]; i++)
+			clock(false);
+		return;
+	case 0x81:
+	case 0x83:
+		rx.push_back(0x00);
+		return;
+	case 0xAA:
+		rx.push_back(0xFA);
+		rx.push_back(0xAA);
+		return;
+	case 0x80:
+	case 0x82:
+	case 0x86:
+	case 0x85:
+	case 0x87:
+	case 0x8A:
+	case 0x8D:
+	case 0x97:
+		return;
+	default:
+		cerr << "Stub got unknown MPSSE command 0x" << hex << (int) command
+				<< dec << endl;
+		badCommand = true;
+	}
+}
+
+FT_STATUS WINAPI FT_Open(int, FT_HANDLE *handle) {
+	*handle = (FT_HANDLE) 1;
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_Close(FT_HANDLE) {
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_ResetDevice(FT_HANDLE) {
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_SetBitMode(FT_HANDLE, UCHAR, UCHAR) {
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_SetChars(FT_HANDLE, UCHAR, UCHAR, UCHAR, UCHAR) {
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_SetTimeouts(FT_HANDLE, ULONG read, ULONG) {
+	lock_guard<mutex> lock(stubMutex);
+	readTimeout = read;
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_SetLatencyTimer(FT_HANDLE, UCHAR) {
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_SetUSBParameters(FT_HANDLE, ULONG, ULONG) {
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_SetEventNotification(FT_HANDLE, DWORD mask, PVOID param) {
+	lock_guard<mutex> lock(stubMutex);
+	notify = (mask & FT_EVENT_RXCHAR) ? param : NULL;
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_GetQueueStatus(FT_HANDLE, DWORD *count) {
+	lock_guard<mutex> lock(stubMutex);
+	*count = rx.size();
+	return FT_OK;
+}
+
+// Blocks until count bytes are waiting or the read timeout passes, like the driver
+FT_STATUS WINAPI FT_Read(FT_HANDLE, LPVOID buffer, DWORD count,
+		LPDWORD read) {
+	unique_lock<mutex> lock(stubMutex);
+	rxReady.wait_for(lock, chrono::milliseconds(readTimeout),
+			[count] {return rx.size() >= count;});
+	DWORD n = 0;
+	while (n < count && !rx.empty()) {
+		((BYTE*) buffer)[n++] = rx.front();
+		rx.pop_front();
+	}
+	*read = n;
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_Write(FT_HANDLE, LPVOID buffer, DWORD count,
+		LPDWORD written) {
+	PVOID event;
+	bool received;
+	{
+		lock_guard<mutex> lock(stubMutex);
+		size_t before = rx.size();
+		partial.insert(partial.end(), (BYTE*) buffer, (BYTE*) buffer + count);
+		size_t offset = 0;
+		while (offset < partial.size()) {
+			size_t length = commandLength(&partial[offset],
+					partial.size() - offset);
+			if (length == 0 || offset + length > partial.size())
+				break;
+			execute(&partial[offset]);
+			offset += length;
+		}
+		partial.erase(partial.begin(), partial.begin() + offset);
+		received = rx.size() > before;
+		event = notify;
+	}
+	*written = count;
+	if (received) {
+		rxReady.notify_all();
+		// signaled after stubMutex is released, RxEvent::wait() holds its
+		// own mutex while it calls FT_GetQueueStatus()
+		if (event != NULL) {
+#ifdef _WIN32
+			SetEvent((HANDLE) event);
+#else
+			EVENT_HANDLE *e = (EVENT_HANDLE*) event;
+			pthread_mutex_lock(&e->eMutex);
+			e->iVar = 1;
+			pthread_cond_signal(&e->eCondVar);
+			pthread_mutex_unlock(&e->eMutex);
+#endif
+		}
+	}
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_GetDeviceInfo(FT_HANDLE, FT_DEVICE *type, LPDWORD id,
+		PCHAR serial, PCHAR description, LPVOID) {
+	if (type != NULL)
+		*type = FT_DEVICE_2232H;
+	if (id != NULL)
+		*id = 0x04036010;
+	if (serial != NULL)
+		strcpy(serial, "STUB0001");
+	if (description != NULL)
+		strcpy(description, "Stub A");
+	return FT_OK;
+}
+
+FT_STATUS WINAPI FT_Purge(FT_HANDLE, ULONG mask) {
+	lock_guard<mutex> lock(stubMutex);
+	if (mask & FT_PURGE_RX)
+		rx.clear();
+	return FT_OK;
+}
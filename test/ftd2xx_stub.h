@@ -0,0 +1,47 @@
+/*
+ * ftd2xx_stub.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef FTD2XX_STUB_H_
+#define FTD2XX_STUB_H_
+
+#include "jtag_fsm.h"
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+/*
+ * The JTAG chain behind the stub FT_* functions in ftd2xx_stub.cpp. The tests
+ * link against the stub instead of libftd2xx, it runs the MPSSE commands Jtag
+ * sends against this chain and queues up whatever TDO they read.
+ *
+ * Device 0 is the one closest to TDO, matching Jtag::setPadding(). An
+ * instruction of all ones is BYPASS, anything else selects a test register
+ * that captures the last value it was updated with.
+ */
+class StubChain {
+public:
+	class Device {
+	public:
+		unsigned int irLength;
+		uint32_t instruction; // latched on UPDATE_IR
+		vector<bool> data; // the test register, latched on UPDATE_DR
+		deque<bool> shift; // whichever register is between TDI and TDO
+
+		bool bypassed() const;
+	};
+
+	static void reset(const vector<unsigned int>&, unsigned int);
+	static Device& device(unsigned int);
+	static Jtag_fsm::State state();
+	static unsigned long lastShift();
+	static unsigned long updates();
+	static unsigned long idleClocks();
+	static bool failed();
+};
+
+#endif /* FTD2XX_STUB_H_ */
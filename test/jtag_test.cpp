@@ -0,0 +1,218 @@
+/*
+ * jtag_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "tests.h"
+#include "ftd2xx_stub.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+// Heap allocations made on the test's own thread. The stub's queues allocate
+// on the writer thread so they aren't counted.
+static atomic<unsigned long> heapAllocations(0);
+static const thread::id testThread = this_thread::get_id();
+
+void* operator new(size_t size) {
+	if (this_thread::get_id() == testThread)
+		heapAllocations++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+// Resets the chain and loads a test instruction into target, BYPASS everywhere else
+bool selectDevice(Jtag &jtag, const vector<unsigned int> &irLengths,
+		unsigned int target, unsigned int dataLength) {
+	StubChain::reset(irLengths, dataLength);
+	if (!jtag.resetState())
+		return false;
+
+	unsigned int irHeader = 0;
+	unsigned int irTrailer = 0;
+	for (unsigned int i = 0; i < irLengths.size(); i++) {
+		if (i < target)
+			irHeader += irLengths[i];
+		else if (i > target)
+			irTrailer += irLengths[i];
+	}
+	jtag.setPadding(irHeader, irTrailer, target, irLengths.size() - target - 1);
+
+	return jtag.navigateToState(Jtag_fsm::SHIFT_IR)
+			&& jtag.shiftData(irLengths[target], 0x2, NULL)
+			&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE);
+}
+
+// Writes random data to one device's test register then reads it back. The
+// stub shows whether the padding put the data in the right place and whether
+// the scan left SHIFT_DR on exactly its last bit.
+static void testFraming(Jtag &jtag, const vector<unsigned int> &irLengths,
+		unsigned int target, unsigned int bits, BitBuffer::BitOrder order) {
+	stringstream name;
+	name << bits << " bits " << (order == BitBuffer::LSB_FIRST ? "LSB" : "MSB")
+			<< " first into device " << target << " of " << irLengths.size();
+
+	if (!check(selectDevice(jtag, irLengths, target, bits),
+			name.str() + ": selecting the device"))
+		return;
+
+	// each scan leaves what it shifted in for the next one to read
+	BitBuffer data = randomBits(bits);
+	BitBuffer zeros(bits);
+	BitBuffer tdo(bits);
+	auto scan = [&](const BitBuffer *tdi, BitBuffer *out) {
+		return jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+				&& jtag.shiftData(bits, tdi ? tdi->data() : NULL,
+						out ? out->data() : NULL, order)
+				&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE);
+	};
+	check(scan(&data, NULL) && scan(NULL, &tdo) && sameBits(data, tdo, order),
+			name.str() + ": write then read");
+	check(scan(&data, &tdo) && sameBits(zeros, tdo, order),
+			name.str() + ": read with NULL tdi");
+	check(scan(NULL, &tdo) && sameBits(data, tdo, order),
+			name.str() + ": read with tdi");
+	check(scan(&data, NULL) && scan(NULL, NULL) && scan(NULL, &tdo)
+			&& sameBits(zeros, tdo, order),
+			name.str() + ": write with NULL tdi");
+
+	check(jtag.sendCommands()
+			&& StubChain::lastShift() == bits + irLengths.size() - 1
+					&& StubChain::state() == Jtag_fsm::RUN_TEST_IDLE,
+			name.str() + ": scan length");
+	for (unsigned int i = 0; i < irLengths.size(); i++)
+		check(StubChain::device(i).bypassed() == (i != target),
+				name.str() + ": instruction of device " + to_string(i));
+	check(!StubChain::failed(), name.str() + ": MPSSE commands");
+}
+
+// Deferred checks against the value in the test register, one with a mask
+// that hides the bits that differ and one that has to fail
+static void testChecks(Jtag &jtag) {
+	const unsigned int bits = 77;
+	if (!check(selectDevice(jtag, { 6, 4, 8 }, 1, bits), "checks: selecting"))
+		return;
+
+	BitBuffer data = randomBits(bits);
+	BitBuffer wrong = data;
+	BitBuffer mask = BitBuffer::ones(bits);
+	wrong.setBit(40, !data.getBit(40));
+	mask.setBit(40, false);
+
+	jtag.setDeferChecks(true);
+	check(jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+			&& jtag.shiftData(data, NULL)
+			&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE), "checks: write");
+	for (int i = 0; i < 3; i++)
+		check(jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+				&& jtag.shiftData(data, data, BitBuffer(), "checks: match")
+				&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE),
+				"checks: queue match");
+	check(jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+			&& jtag.shiftData(data, wrong, mask, "checks: masked")
+			&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE),
+			"checks: queue masked");
+	check(jtag.resolveChecks(), "checks: expected matches");
+
+	check(jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+			&& jtag.shiftData(data, wrong, BitBuffer(), "checks: mismatch")
+			&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE),
+			"checks: queue mismatch");
+	cerr << "(the next mismatch is expected)" << endl;
+	check(!jtag.resolveChecks(), "checks: expected mismatch");
+
+	// dropped checks mustn't leave their TDO in front of the next read
+	check(jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+			&& jtag.shiftData(data, data, BitBuffer(), "checks: dropped")
+			&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE),
+			"checks: queue dropped");
+	jtag.setDeferChecks(false);
+	BitBuffer tdo;
+	check(jtag.navigateToState(Jtag_fsm::SHIFT_DR) && jtag.shiftData(data, &tdo)
+			&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE)
+			&& sameBits(data, tdo, BitBuffer::LSB_FIRST),
+			"checks: read after dropping");
+}
+
+// The same scans over and over shouldn't need any buffers the first pass
+// didn't, from the pool or anywhere else on the heap
+static void testAllocations(Jtag &jtag) {
+	const unsigned int bits = 1000;
+	if (!check(selectDevice(jtag, { 6, 6 }, 0, bits), "allocations: selecting"))
+		return;
+
+	BitBuffer data = randomBits(bits);
+	BitBuffer tdo(bits);
+	BitBuffer read;
+	BitBuffer deferred[4];
+	jtag.setDeferChecks(true);
+	auto pass = [&]() {
+		bool ok = jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+				&& jtag.shiftData(data, NULL)
+				&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE);
+		for (int i = 0; i < 8; i++)
+			ok = ok && jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+					&& jtag.shiftData(data, data, BitBuffer(), "allocations")
+					&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE);
+		for (BitBuffer &captured : deferred)
+			ok = ok && jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+					&& jtag.deferRead(data, &captured)
+					&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE);
+		ok = ok && jtag.resolveChecks();
+		ok = ok && jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+				&& jtag.shiftData(data, &read)
+				&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE);
+		ok = ok && jtag.navigateToState(Jtag_fsm::SHIFT_DR)
+				&& jtag.shiftData(bits, data.data(), tdo.data())
+				&& jtag.navigateToState(Jtag_fsm::RUN_TEST_IDLE);
+		for (const BitBuffer &captured : deferred)
+			ok = ok && sameBits(data, captured, BitBuffer::LSB_FIRST);
+		return ok && sameBits(data, read, BitBuffer::LSB_FIRST)
+				&& sameBits(data, tdo, BitBuffer::LSB_FIRST);
+	};
+
+	check(pass(), "allocations: warm-up pass");
+	unsigned long allocations = jtag.getAllocations();
+	unsigned long heap = heapAllocations;
+	bool ok = true;
+	for (int i = 0; i < 20; i++)
+		ok = pass() && ok;
+	heap = heapAllocations - heap;
+	check(ok, "allocations: repeated passes");
+	check(jtag.getAllocations() == allocations,
+			"allocations: " + to_string(jtag.getAllocations() - allocations)
+					+ " new pool buffers after warm-up");
+	check(heap == 0,
+			"allocations: " + to_string(heap) + " heap allocations after warm-up");
+	jtag.setDeferChecks(false);
+}
+
+void testJtag(Jtag &jtag) {
+	const vector<vector<unsigned int>> chains = { { 6 }, { 6, 4, 8 } };
+	const unsigned int sizes[] = { 1, 2, 7, 8, 9, 15, 16, 17, 64, 65, 1000 };
+	for (const vector<unsigned int> &chain : chains)
+		for (unsigned int target = 0; target < chain.size(); target++)
+			for (unsigned int bits : sizes) {
+				testFraming(jtag, chain, target, bits, BitBuffer::LSB_FIRST);
+				testFraming(jtag, chain, target, bits, BitBuffer::MSB_FIRST);
+			}
+
+	// more than one read chunk so the reads are streamed
+	testFraming(jtag, { 6, 4 }, 0, 300001, BitBuffer::LSB_FIRST);
+	testFraming(jtag, { 6, 4 }, 1, 300001, BitBuffer::MSB_FIRST);
+
+	testChecks(jtag);
+	testAllocations(jtag);
+}
@@ -0,0 +1,152 @@
+/*
+ * svf_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "tests.h"
+#include "ftd2xx_stub.h"
+#include "svf_player.h"
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// Plays svf against a fresh chain. The SVF gives its own padding so Jtag adds none.
+static bool play(Jtag &jtag, const vector<unsigned int> &irLengths,
+		const string &svf) {
+	StubChain::reset(irLengths, 12);
+	if (!jtag.resetState())
+		return false;
+	jtag.setPadding(0, 0, 0, 0);
+
+	stringstream in(svf);
+	SvfPlayer player(&jtag);
+	return player.play(in);
+}
+
+// True if the device's test register was last updated with value
+static bool holds(unsigned int device, uint32_t value) {
+	const vector<bool> &data = StubChain::device(device).data;
+	for (unsigned int i = 0; i < data.size(); i++)
+		if (data[i] != (((value >> i) & 1) != 0))
+			return false;
+	return true;
+}
+
+// Statements split over lines, sharing lines and broken up by comments
+static void testStatements(Jtag &jtag) {
+	check(play(jtag, { 6 },
+			"ENDDR DRPAUSE; ENDIR IDLE;\n"
+			"SIR 6\n"
+			"  TDI (02); SDR 12 TDI (\n"
+			"  a // the first digit\n"
+			"  bc) ! and the rest\n"
+			"  ;\n"
+			"SDR\n"
+			"12 TDO(abc)\n"
+			"\n"
+			"MASK(fff) TDI(000);\n")
+			&& StubChain::state() == Jtag_fsm::PAUSE_DR && holds(0, 0x000)
+			&& StubChain::device(0).instruction == 0x02,
+			"svf statements: split over lines");
+
+	cerr << "(the next SVF errors are expected)" << endl;
+	check(!play(jtag, { 6 }, "SIR 6 TDI (02);\nSDR 12 TDI (abc)\n"),
+			"svf statements: missing ;");
+	check(!play(jtag, { 6 }, "SDR 12 TDI (ab;c);\n"),
+			"svf statements: ; inside a value");
+}
+
+// TDI and MASK carry over to the next scan of the same length, TDO doesn't
+static void testPersistence(Jtag &jtag) {
+	check(play(jtag, { 6 },
+			"SIR 6 TDI (02) TDO (01) MASK (03);\n"
+			"SIR 6 TDO (3d);\n" // 02 and the mask carry over
+			"SDR 12 TDI (abc);\n"
+			"SDR 12 TDI (123) TDO (abc) MASK (0ff);\n"
+			"SDR 12 TDO (f23);\n" // 123 and the mask carry over
+			"SDR 12 TDI (456) MASK (fff);\n"
+			"SDR 12 TDI (789);\n") // f23 isn't checked against 456
+			&& holds(0, 0x789), "svf persistence: TDI, TDO and MASK");
+
+	check(!play(jtag, { 6 },
+			"SIR 6 TDI (02);\n"
+			"SDR 12 TDI (abc);\n"
+			"SDR 12 TDI (123) TDO (abc) MASK (0ff);\n"
+			"SDR 12 TDI (456) TDO (f23) MASK (fff);\n"),
+			"svf persistence: MASK replaced");
+
+	// a new length starts over, the mask no longer hides the mismatch
+	check(!play(jtag, { 6 },
+			"SIR 6 TDI (02);\n"
+			"SDR 12 TDI (abc) MASK (000);\n"
+			"SDR 8 TDI (00);\n"
+			"SDR 12 TDI (000) TDO (fff);\n"),
+			"svf persistence: new length");
+	check(!play(jtag, { 6 },
+			"SIR 6 TDI (02);\n"
+			"SDR 12 TDI (abc);\n"
+			"SDR 8;\n"),
+			"svf persistence: TDI dropped with the length");
+}
+
+// HIR and HDR pad the devices closest to TDO, TIR and TDR the ones closest to
+// TDI. Only the middle device of three should see the instruction and data.
+static void testPadding(Jtag &jtag) {
+	const string padding =
+			"HIR 6 TDI (3f);\n"
+			"TIR 8 TDI (ff);\n"
+			"HDR 1 TDI (0) TDO (0);\n"
+			"TDR 1 TDI (1);\n"
+			"SIR 4 TDI (2);\n"
+			"SDR 12 TDI (abc);\n";
+
+	check(play(jtag, { 6, 4, 8 }, padding + "SDR 12 TDI (5a5) TDO (abc);\n")
+			&& StubChain::device(0).bypassed() && StubChain::device(2).bypassed()
+			&& StubChain::device(1).instruction == 0x2 && holds(1, 0x5a5)
+			&& StubChain::lastShift() == 14,
+			"svf padding: header and trailer");
+	check(!play(jtag, { 6, 4, 8 }, padding + "SDR 12 TDI (5a5) TDO (abd);\n"),
+			"svf padding: mismatch in the body");
+	check(!play(jtag, { 6, 4, 8 },
+			padding + "HDR 1 TDI (0) TDO (1);\nSDR 12 TDI (5a5) TDO (abc);\n"),
+			"svf padding: mismatch in the header");
+	check(!StubChain::failed(), "svf padding: MPSSE commands");
+}
+
+// RUNTEST counts TCK exactly, turns times into TCK at the current rate and
+// takes the larger of the two when both are given
+static void testRunTest(Jtag &jtag) {
+	double freq = jtag.getFreq();
+	if (!check(jtag.setFreq(1000000), "svf runtest: setting TCK"))
+		return;
+
+	check(play(jtag, { 6 }, "RUNTEST 100 TCK;\n")
+			&& StubChain::idleClocks() == 100, "svf runtest: TCK");
+	check(play(jtag, { 6 }, "RUNTEST IDLE 10 TCK 1.0E-3 SEC;\n")
+			&& StubChain::idleClocks() == 1000, "svf runtest: time");
+	check(play(jtag, { 6 }, "RUNTEST 1.0E-3 SEC MAXIMUM 1 SEC;\n")
+			&& StubChain::idleClocks() == 1000, "svf runtest: maximum");
+	check(play(jtag, { 6 }, "FREQUENCY 1E5 HZ;\nRUNTEST 2E-3 SEC;\n")
+			&& StubChain::idleClocks() == 200 && jtag.getFreq() == 1000000,
+			"svf runtest: time at a lower frequency");
+	check(play(jtag, { 6 }, "RUNTEST 2000 TCK 1.0E-3 SEC;\n")
+			&& StubChain::idleClocks() == 2000, "svf runtest: TCK over time");
+	check(play(jtag, { 6 }, "RUNTEST 20 TCK ENDSTATE DRPAUSE;\n")
+			&& StubChain::idleClocks() == 20
+			&& StubChain::state() == Jtag_fsm::PAUSE_DR,
+			"svf runtest: end state");
+	check(play(jtag, { 6 }, "RUNTEST DRPAUSE 20 TCK;\n")
+			&& StubChain::idleClocks() == 0
+			&& StubChain::state() == Jtag_fsm::PAUSE_DR,
+			"svf runtest: run state");
+	jtag.setFreq(freq);
+}
+
+void testSvf(Jtag &jtag) {
+	testStatements(jtag);
+	testPersistence(jtag);
+	testPadding(jtag);
+	testRunTest(jtag);
+}
@@ -0,0 +1,63 @@
+/*
+ * test_main.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "tests.h"
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+static unsigned int failures = 0;
+static mt19937 rng(1);
+
+bool check(bool ok, const string &what) {
+	if (!ok) {
+		cerr << "FAIL: " << what << endl;
+		failures++;
+	}
+	return ok;
+}
+
+BitBuffer randomBits(unsigned int bits) {
+	BitBuffer buffer(bits);
+	for (unsigned int i = 0; i < buffer.byteCount(); i++)
+		buffer.data()[i] = rng();
+	return buffer;
+}
+
+bool sameBits(const BitBuffer &expected, const BitBuffer &actual,
+		BitBuffer::BitOrder order) {
+	if (actual.size() < expected.size())
+		return false;
+	for (unsigned int i = 0; i < expected.size(); i++)
+		if (expected.getBit(i, order) != actual.getBit(i, order))
+			return false;
+	return true;
+}
+
+int main() {
+	testConfig();
+
+	Jtag jtag;
+	if (jtag.connect(0) != FT_OK || !jtag.initialize()) {
+		cerr << "Failed to initialize against the stub!" << endl;
+		return 1;
+	}
+
+	testJtag(jtag);
+	testSvf(jtag);
+	testBsdl(jtag);
+	testXsvf(jtag);
+
+	jtag.disconnect();
+
+	if (failures > 0) {
+		cerr << failures << " checks failed" << endl;
+		return 1;
+	}
+	cout << "All checks passed" << endl;
+	return 0;
+}
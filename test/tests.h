@@ -0,0 +1,35 @@
+/*
+ * tests.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef TESTS_H_
+#define TESTS_H_
+
+#include "bit_buffer.h"
+#include "jtag.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * The checks shared by the test files and the groups of tests test_main.cpp
+ * runs. The groups that take a Jtag run against the stub driver in
+ * ftd2xx_stub.cpp, the others don't touch it.
+ */
+
+bool check(bool, const string&);
+BitBuffer randomBits(unsigned int);
+bool sameBits(const BitBuffer&, const BitBuffer&, BitBuffer::BitOrder);
+bool selectDevice(Jtag&, const vector<unsigned int>&, unsigned int,
+		unsigned int);
+
+void testBsdl(Jtag&);
+void testConfig();
+void testJtag(Jtag&);
+void testSvf(Jtag&);
+void testXsvf(Jtag&);
+
+#endif /* TESTS_H_ */
@@ -0,0 +1,47 @@
+/*
+ * xsvf_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "tests.h"
+#include "ftd2xx_stub.h"
+#include "xsvf_player.h"
+#include <sstream>
+
+using namespace std;
+
+// A check that fails until it's retried. The first capture is the register's
+// reset value, the retry has to reach SHIFT_DR again through PAUSE_DR so the
+// data shifted in by the first attempt comes out without being updated.
+static void testRetry(Jtag &jtag) {
+	if (!check(selectDevice(jtag, { 6 }, 0, 16), "xsvf retry: selecting"))
+		return;
+
+	const char program[] = {
+			0x07, 3, // XREPEAT
+			0x04, 0, 0, 0, 100, // XRUNTEST 100us
+			0x02, 6, 0x02, // XSIR
+			0x08, 0, 0, 0, 16, // XSDRSIZE
+			0x01, (char) 0xFF, (char) 0xFF, // XTDOMASK
+			0x09, (char) 0xA5, (char) 0xC3, (char) 0xA5, (char) 0xC3, // XSDRTDO
+			0x00 // XCOMPLETE
+	};
+	stringstream in(string(program, sizeof(program)));
+	XsvfPlayer player(&jtag);
+	check(player.play(in), "xsvf retry: play");
+	check(jtag.sendCommands() && StubChain::updates() == 1,
+			"xsvf retry: " + to_string(StubChain::updates())
+					+ " updates of the data register");
+
+	bool latched = true;
+	const vector<bool> &data = StubChain::device(0).data;
+	for (unsigned int i = 0; i < 16; i++)
+		latched = latched && data[i] == (((0xA5C3 >> i) & 1) != 0);
+	check(latched, "xsvf retry: latched value");
+	check(!StubChain::failed(), "xsvf retry: MPSSE commands");
+}
+
+void testXsvf(Jtag &jtag) {
+	testRetry(jtag);
+}